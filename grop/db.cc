@@ -10,6 +10,8 @@
 #include "opt.h"
 #include "db.h"
 #include "util.h"
+#include "porg/parallel.h"
+#include "porg/catalog.h"
 #include <gtkmm/messagedialog.h>
 #include <gtkmm/progressbar.h>
 #include <gtkmm/image.h>
@@ -38,34 +40,80 @@ DB::DB()
 	dialog.show_all();
 
 	Glib::Dir dir(Opt::logdir());
-	int pkg_cnt = std::vector<string>(dir.begin(), dir.end()).size();	
-	s_pkgs.reserve(pkg_cnt);
-	float cnt = 0;
+	std::vector<string> names;
 
 	for (Glib::DirIterator d = dir.begin(); d != dir.end(); ++d) {
+		// skip hidden files (like the index of the database)
+		if ((*d)[0] != '.'
+		&& Glib::file_test(Opt::logdir() + "/" + *d, Glib::FILE_TEST_IS_REGULAR))
+			names.push_back(*d);
+	}
 
-		if (!Glib::file_test(Opt::logdir() + "/" + *d, Glib::FILE_TEST_IS_REGULAR))
-			continue;
+	// read the logs in worker threads, while this one keeps the progress
+	// bar moving. Packages with an up to date entry in the catalog are
+	// taken from there, and the rest of their header is read when the
+	// properties window is shown.
 
-		dialog.set_secondary_text(*d);
-		main_iter();
-		
-		try 
-		{	
-			Pkg* pkg = new Pkg(*d);
-			pkg->read_log();
-			s_pkgs.push_back(pkg);
-			s_total_size += pkg->size();
+	Porg::Catalog catalog;
+	std::vector<Pkg*> pkgs(names.size(), 0);
+	std::vector<string> errors(names.size());
+	std::vector<struct stat> logs(names.size());
+	std::vector<char> uncataloged(names.size(), false);	// written concurrently
+
+	Porg::Workers workers(names.size(), [&](size_t i) {
+		try
+		{
+			Pkg* pkg = new Pkg(names[i]);
+			pkgs[i] = pkg;
+
+			bool log_stat = !stat(pkg->log().c_str(), &logs[i]);
+			Porg::Catalog::Entry const* e;
+
+			if (log_stat && (e = catalog.find(names[i], logs[i])))
+				pkg->read_catalog(*e);
+			else {
+				pkg->read_log(true);	// files are read when they are shown
+				uncataloged[i] = log_stat;
+			}
 		}
-		catch (std::exception const& x) 
+		catch (std::exception const& x)
 		{
-			g_warning("%s", x.what()); 
+			delete pkgs[i];
+			pkgs[i] = 0;
+			errors[i] = x.what();
 		}
-		
-		progressbar->set_fraction(cnt++ / pkg_cnt);
+	});
+
+	while (!workers.wait(50)) {
+		size_t done = workers.done();
+		if (done < names.size())
+			dialog.set_secondary_text(names[done]);
+		progressbar->set_fraction(float(done) / names.size());
 		main_iter();
 	}
 
+	workers.join();
+
+	for (uint i = 0; i < names.size(); ++i) {
+		if (pkgs[i] && uncataloged[i])
+			catalog.set(*pkgs[i], logs[i]);
+	}
+
+	catalog.save(names);
+
+	// merge the packages in order
+
+	s_pkgs.reserve(names.size());
+
+	for (uint i = 0; i < names.size(); ++i) {
+		if (pkgs[i]) {
+			s_pkgs.push_back(pkgs[i]);
+			s_total_size += pkgs[i]->size();
+		}
+		else
+			g_warning("%s", errors[i].c_str());
+	}
+
 	s_initialized = true;
 }
 
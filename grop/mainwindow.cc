@@ -258,8 +258,20 @@ void MainWindow::on_find_file()
 
 void MainWindow::on_properties()
 {
-	if (m_selected_pkg)
-		Properties::instance(*m_selected_pkg, *this);
+	if (!m_selected_pkg)
+		return;
+
+	try
+	{
+		m_selected_pkg->load_header();
+	}
+	catch (std::exception const& x)
+	{
+		run_error_dialog(x.what(), this);
+		return;
+	}
+
+	Properties::instance(*m_selected_pkg, *this);
 }
 
 
@@ -12,6 +12,8 @@
 #include "util.h"
 #include "porg/file.h"
 #include "porg/common.h"
+#include "porg/index.h"
+#include "porg/pathlist.h"
 #include "removepkg.h"
 #include "porg/common.h"
 #include <glibmm/miscutils.h>	// path_get_dirname()
@@ -112,6 +114,8 @@ void RemovePkg::remove()
 {
 	float cnt = 1;
 	int cnt_shared = 0, cnt_excluded = 0, cnt_removed = 0, cnt_error = 0;
+	Porg::SharedFiles shared;
+	Porg::PathList const skip(Opt::remove_skip());
 
 	for (Pkg::const_iter f(m_pkg.files().begin()); f != m_pkg.files().end(); ++f) {
 		
@@ -121,13 +125,13 @@ void RemovePkg::remove()
 		main_iter();
 
 		// skip excluded
-		if (Porg::in_paths(file, Opt::remove_skip())) {
+		if (skip.match(file)) {
 			report("'" + file + "': excluded", m_tag_skipped);
 			cnt_excluded++;
 		}
 
 		// skip shared files
-		else if (m_pkg.is_shared(*f, DB::pkgs())) {
+		else if (shared.is_shared(file)) {
 			report("'" + file + "': shared", m_tag_skipped);
 			cnt_shared++;
 		}
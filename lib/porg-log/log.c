@@ -10,8 +10,13 @@
 #include <dirent.h>
 #include <dlfcn.h>
 #include <fcntl.h>			  
+#include <pthread.h>
 #include <stdarg.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#ifdef __linux__
+#	include <sys/syscall.h>
+#endif
 
 #ifndef RTLD_NEXT
 #	define RTLD_NEXT ((void *) -1l)
@@ -21,6 +26,14 @@
 #define HAVE_AT_FUNCS (HAVE_OPENAT && HAVE_LINKAT && HAVE_SYMLINKAT && HAVE_RENAMEAT)
 
 #define PORG_BUFSIZE  4096
+#define PORG_LOGBUFSIZE  65536
+#define PORG_MINFD  100
+#define PORG_DGRAMSIZE  16384
+#define PORG_SEENSIZE  32768	/* must be a power of 2 */
+#define PORG_SEENWAYS  4
+#define PORG_DIRCACHE  8
+#define PORG_DIRBUFSIZE  32768
+#define PORG_TREEDEPTH  128
 
 static int	(*libc_open)		(const char*, int, ...);
 static int	(*libc_creat)		(const char*, mode_t);
@@ -29,6 +42,20 @@ static int	(*libc_link)		(const char*, const char*);
 static int	(*libc_symlink)		(const char*, const char*);
 static FILE*(*libc_fopen)		(const char*, const char*);
 static FILE*(*libc_freopen)		(const char*, const char*, FILE*);
+static int	(*libc_execve)		(const char*, char* const[], char* const[]);
+static int	(*libc_execv)		(const char*, char* const[]);
+static int	(*libc_execvp)		(const char*, char* const[]);
+static void	(*libc__exit)		(int);
+static void	(*libc__Exit)		(int);
+static int	(*libc_close)		(int);
+static int	(*libc_dup2)		(int, int);
+static int	(*libc_chdir)		(const char*);
+static int	(*libc_fchdir)		(int);
+
+#ifdef __GLIBC__
+static int	(*libc_execvpe)		(const char*, char* const[], char* const[]);
+static int	(*libc_dup3)		(int, int, int);
+#endif
 
 #if HAVE_AT_FUNCS
 static int	(*libc_openat)		(int, const char*, int, ...);
@@ -51,6 +78,104 @@ static int	(*libc_openat64)	(int, const char*, int, ...);
 static char* porg_tmpfile;
 static char* porg_debug;
 
+/*
+ * The program may log files from several threads at once. The state shared
+ * by all the threads is guarded by these locks: porg_log_lock guards the
+ * buffer of records and the descriptors they're written to, and porg_dir_lock
+ * the caches of directories. When both are needed, porg_log_lock must be
+ * taken first. Everything else is either read-only once porg_init() is done,
+ * or kept in automatic variables.
+ */
+static pthread_mutex_t porg_init_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t porg_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t porg_dir_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int porg_initialized;
+static __thread int porg_initializing;
+
+/* 
+ * Logged paths are collected in porg_logbuf, and sent to porg in large chunks.
+ * Each chunk holds only whole records, so records of concurrent processes
+ * never get mixed up.
+ *
+ * Chunks are sent as datagrams through the socket inherited from porg, whose
+ * descriptor and inode number are given in PORG_LOGFD ("fd:inode"). If the
+ * socket is not available (e.g. the program closed it), they are appended to
+ * the tmp file instead, with a single write() on a descriptor opened with
+ * O_APPEND.
+ */
+static char porg_logbuf[PORG_LOGBUFSIZE];
+static size_t porg_loglen;
+static int porg_fd = -1;
+static dev_t porg_fd_dev;
+static ino_t porg_fd_ino;
+static int porg_sock = -1;
+static unsigned long porg_sock_ino;
+
+/*
+ * Hashes of the paths already logged by this process, so that files opened
+ * many times are logged only once. It's a set associative cache of fixed
+ * size: when a bucket is full, an entry is evicted, so that the path may be
+ * logged again at worst.
+ */
+static uint64_t porg_seen_tab[PORG_SEENSIZE];
+
+/*
+ * Cache of the CWD, and of the paths of directories referred to by file
+ * descriptors (for the *at() functions), indexed by descriptor.
+ */
+static char porg_cwd[PORG_BUFSIZE];
+
+static struct porg_dir
+{
+	int		valid;
+	int		fd;
+	dev_t	dev;
+	ino_t	ino;
+	char	path[PORG_BUFSIZE];
+} porg_dirs[PORG_DIRCACHE];
+
+
+/*
+ * Directory tree being walked by porg_log_tree(), depth first, with one open
+ * directory per level, up to PORG_TREEDEPTH levels. Where available,
+ * getdents64() is used, which reads many entries (with their types) in a
+ * single call, into a buffer shared by all the levels: the offset of the
+ * next entry of each directory is kept, to go on reading it from there when
+ * coming back from a subdirectory.
+ */
+#ifdef SYS_getdents64
+struct porg_dirent64
+{
+	uint64_t		d_ino;
+	int64_t			d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char			d_name[1];
+};
+#endif
+
+struct porg_dirstream
+{
+	int		fd;
+	size_t	path_len;	/* length of its path in porg_tree.path */
+#ifdef SYS_getdents64
+	int64_t	off;		/* offset of the next entry */
+#else
+	DIR*	dir;
+#endif
+};
+
+struct porg_tree
+{
+	struct porg_dirstream	dirs[PORG_TREEDEPTH];
+	char	path[PORG_BUFSIZE];
+#ifdef SYS_getdents64
+	char	buf[PORG_DIRBUFSIZE];
+	long	len;
+	long	pos;
+#endif
+};
+
 
 /* Fake declarations of libc's internal __open and __open64 */
 #if !HAVE_DECL___OPEN
@@ -61,9 +186,9 @@ int __open64(const char*, int, ...);
 #endif
 
 
-static void porg_vprintf(const char* fmt, va_list ap)
+static void porg_vprintf(int always, const char* fmt, va_list ap)
 {
-	if (porg_debug) {
+	if (always || porg_debug) {
 		fflush(stdout);
 		fputs("porg-log :: ", stderr);
 		vfprintf(stderr, fmt, ap);
@@ -76,39 +201,176 @@ static void porg_die(const char* fmt, ...)
 {
 	va_list ap;
 	va_start(ap, fmt);
-	porg_vprintf(fmt, ap);
+	porg_vprintf(0, fmt, ap);
 	va_end(ap);
 	exit(EXIT_FAILURE);
 }
 
 
+static void porg_warn(const char* fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	porg_vprintf(0, fmt, ap);
+	va_end(ap);
+}
+
+
+/*
+ * Like porg_warn(), but printed even if PORG_DEBUG is not set, for files
+ * that should be logged but are not.
+ */
+static void porg_error(const char* fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	porg_vprintf(1, fmt, ap);
+	va_end(ap);
+}
+
+
+/*
+ * Get the CWD, which is cached until the program calls chdir() or fchdir(),
+ * or renames a directory.
+ * Must be called with porg_dir_lock held.
+ */
+static const char* porg_get_cwd()
+{
+	if (!porg_cwd[0] && !getcwd(porg_cwd, PORG_BUFSIZE)) {
+		porg_cwd[0] = 0;
+		return NULL;
+	}
+
+	return porg_cwd;
+}
+
+
+/*
+ * Get the path of the directory referred to by file descriptor fd. 
+ * Paths are cached per descriptor, and the cache entry is checked against
+ * the inode of the directory, in case the descriptor has been closed and 
+ * reused behind our back (e.g. by closedir()). Renames of directories
+ * made by this process drop the whole cache (see porg_forget_dirs()).
+ * Must be called with porg_dir_lock held.
+ */
+static const char* porg_get_dirfd_path(int fd)
+{
+	struct porg_dir* d = porg_dirs + fd % PORG_DIRCACHE;
+	struct stat st;
+	const char* cwd;
+#ifndef F_GETPATH
+	char proc[32];
+	ssize_t n;
+#endif
+
+	if (fstat(fd, &st) < 0)
+		return NULL;
+
+	if (d->valid && d->fd == fd && d->dev == st.st_dev && d->ino == st.st_ino)
+		return d->path;
+
+	d->valid = 0;
+
+#ifdef F_GETPATH
+	if (fcntl(fd, F_GETPATH, d->path) < 0 || d->path[0] != '/')
+#else
+	sprintf(proc, "/proc/self/fd/%d", fd);
+	if ((n = readlink(proc, d->path, PORG_BUFSIZE - 1)) > 0)
+		d->path[n] = 0;
+	if (n <= 0 || d->path[0] != '/')
+#endif
+	{
+		/* no /proc: cd to the directory and back to get its path */
+		if (!(cwd = porg_get_cwd()) || libc_fchdir(fd) < 0)
+			return NULL;
+		if (!getcwd(d->path, PORG_BUFSIZE))
+			d->path[0] = 0;
+		if (libc_chdir(cwd) < 0 || !d->path[0])
+			return NULL;
+	}
+
+	d->fd = fd;
+	d->dev = st.st_dev;
+	d->ino = st.st_ino;
+	d->valid = 1;
+
+	return d->path;
+}
+
+
+/*
+ * Forget the cached path of file descriptor fd, which is being closed or
+ * replaced.
+ */
+static void porg_forget_fd(int fd)
+{
+	struct porg_dir* d;
+
+	if (fd < 0)
+		return;
+
+	pthread_mutex_lock(&porg_dir_lock);
+
+	if ((d = porg_dirs + fd % PORG_DIRCACHE)->fd == fd)
+		d->valid = 0;
+
+	pthread_mutex_unlock(&porg_dir_lock);
+}
+
+
+/*
+ * Forget the cached CWD, after the program has changed it.
+ */
+static void porg_forget_cwd()
+{
+	pthread_mutex_lock(&porg_dir_lock);
+	porg_cwd[0] = 0;
+	pthread_mutex_unlock(&porg_dir_lock);
+}
+
+
+/*
+ * Forget the cached CWD and the cached paths of all descriptors, after the
+ * program has renamed a directory, which may be any of them or lead to them.
+ */
+static void porg_forget_dirs()
+{
+	int i;
+
+	pthread_mutex_lock(&porg_dir_lock);
+
+	porg_cwd[0] = 0;
+	for (i = 0; i < PORG_DIRCACHE; i++)
+		porg_dirs[i].valid = 0;
+
+	pthread_mutex_unlock(&porg_dir_lock);
+}
+
+
 /*
  * Get the absolute path, referring relative paths to the CWD, or to directory
  * referred to by file descriptor fd, if non negative.
  */
 static void porg_get_absolute_path(int fd, const char* path, char* abs_path)
 {
-	static char cwd[PORG_BUFSIZE], aux[PORG_BUFSIZE];
+	const char* dir = NULL;
 	int old_errno = errno;
 
-	/* already absolute (or can't get CWD) */
-	if (path[0] == '/' || !getcwd(cwd, PORG_BUFSIZE))
+	if (path[0] != '/') {
+		pthread_mutex_lock(&porg_dir_lock);
+		if ((dir = fd < 0 ? porg_get_cwd() : porg_get_dirfd_path(fd)))
+			strcpy(abs_path, dir);  /* both are PORG_BUFSIZE long */
+		pthread_mutex_unlock(&porg_dir_lock);
+	}
+
+	/* already absolute (or can't get the directory) */
+	if (!dir)
 		strncpy(abs_path, path, PORG_BUFSIZE - 1);
 
-	/* relative to CWD */
-	else if (fd < 0) {
-		memcpy(abs_path, cwd, PORG_BUFSIZE - 1);
-		strncat(abs_path, "/", PORG_BUFSIZE - strlen(abs_path) - 1);
-		strncat(abs_path, path, PORG_BUFSIZE - strlen(abs_path) - 1);
-	}
-	/* relative to directory fd */
-	else if (fchdir(fd) == 0 && getcwd(aux, PORG_BUFSIZE) && chdir(cwd) == 0) {
-		memcpy(abs_path, aux, PORG_BUFSIZE - 1);
+	else {
 		strncat(abs_path, "/", PORG_BUFSIZE - strlen(abs_path) - 1);
 		strncat(abs_path, path, PORG_BUFSIZE - strlen(abs_path) - 1);
 	}
-	else
-		strncpy(abs_path, path, PORG_BUFSIZE - 1);
 
 	abs_path[PORG_BUFSIZE - 1] = 0;
 
@@ -132,10 +394,153 @@ static void* porg_dlsym(const char* symbol)
 }
 
 
-static void porg_init()
+/*
+ * Open the tmp file, unless it's already open. The descriptor is kept open 
+ * across calls, out of the range of the descriptors normally used by the
+ * program, and it's closed on exec.
+ */
+static int porg_open_tmpfile()
 {
-	if (porg_tmpfile) /* already init'ed */
-		return;
+	struct stat st;
+	int fd;
+
+	/* check that the program has not closed our descriptor, or reused it */
+	if (porg_fd >= 0 && !fstat(porg_fd, &st)
+	&& st.st_dev == porg_fd_dev && st.st_ino == porg_fd_ino)
+		return 0;
+
+	porg_fd = -1;
+
+	if ((fd = libc_open(porg_tmpfile, O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0)
+		return -1;
+
+	if ((porg_fd = fcntl(fd, F_DUPFD, PORG_MINFD)) >= 0)
+		libc_close(fd);
+	else
+		porg_fd = fd;
+
+	fcntl(porg_fd, F_SETFD, FD_CLOEXEC);
+
+	if (fstat(porg_fd, &st) < 0) {
+		libc_close(porg_fd);
+		porg_fd = -1;
+		return -1;
+	}
+
+	porg_fd_dev = st.st_dev;
+	porg_fd_ino = st.st_ino;
+
+	return 0;
+}
+
+
+/*
+ * Send the buffered records through the socket, in datagrams of whole 
+ * records. Return the number of bytes sent.
+ */
+static size_t porg_send_logbuf()
+{
+	struct stat st;
+	size_t done = 0, len;
+	ssize_t n;
+
+	/* check that the program has not closed the socket, or reused its fd */
+	if (porg_sock < 0 || fstat(porg_sock, &st) < 0 || !S_ISSOCK(st.st_mode)
+	|| (unsigned long)st.st_ino != porg_sock_ino)
+		return 0;
+
+	while (done < porg_loglen) {
+
+		if ((len = porg_loglen - done) > PORG_DGRAMSIZE) {
+			for (len = PORG_DGRAMSIZE; porg_logbuf[done + len - 1] != '\n'; len--) ;
+		}
+
+		if ((n = send(porg_sock, porg_logbuf + done, len, 0)) >= 0)
+			done += n;
+		else if (errno != EINTR)
+			break;
+	}
+
+	return done;
+}
+
+
+/*
+ * Hand the buffered records over to porg, and empty the buffer.
+ * Must be called with porg_log_lock held.
+ */
+static int porg_write_logbuf()
+{
+	size_t done;
+	ssize_t n;
+	int ret = 0;
+
+	if (!porg_loglen)
+		return 0;
+
+	done = porg_send_logbuf();
+
+	if (done < porg_loglen && porg_open_tmpfile() < 0)
+		ret = -1;
+
+	while (!ret && done < porg_loglen) {
+		if ((n = write(porg_fd, porg_logbuf + done, porg_loglen - done)) >= 0)
+			done += n;
+		else if (errno != EINTR)
+			ret = -1;
+	}
+
+	porg_loglen = 0;
+	return ret;
+}
+
+
+/*
+ * Flush the buffered records before the process exits or execs.
+ */
+static void porg_flush()
+{
+	int old_errno = errno;
+
+	pthread_mutex_lock(&porg_log_lock);
+
+	if (porg_write_logbuf() < 0)
+		porg_warn("%s: write(): %s", porg_tmpfile, strerror(errno));
+
+	pthread_mutex_unlock(&porg_log_lock);
+
+	errno = old_errno;
+}
+
+
+/*
+ * Before forking, flush the buffered records, and hold the locks so that
+ * the child doesn't inherit them locked by another thread.
+ */
+static void porg_fork_prepare()
+{
+	int old_errno = errno;
+
+	pthread_mutex_lock(&porg_log_lock);
+	pthread_mutex_lock(&porg_dir_lock);
+
+	if (porg_write_logbuf() < 0)
+		porg_warn("%s: write(): %s", porg_tmpfile, strerror(errno));
+
+	errno = old_errno;
+}
+
+
+static void porg_fork_release()
+{
+	pthread_mutex_unlock(&porg_dir_lock);
+	pthread_mutex_unlock(&porg_log_lock);
+}
+
+
+static void porg_init_once()
+{
+	char* env;
 
 	/* read the environment */
 	
@@ -143,6 +548,14 @@ static void porg_init()
 		porg_die("variable PORG_TMPFILE undefined");
 		
 	porg_debug = getenv("PORG_DEBUG");
+
+	if ((env = getenv("PORG_LOGFD")) && sscanf(env, "%d:%lu", &porg_sock, &porg_sock_ino) != 2)
+		porg_sock = -1;
+
+	/* flush the buffered records at exit, and before forking */
+
+	atexit(porg_flush);
+	pthread_atfork(porg_fork_prepare, porg_fork_release, porg_fork_release);
 	
 	/* handle system calls */
 	
@@ -153,6 +566,20 @@ static void porg_init()
 	libc_symlink 	= porg_dlsym("symlink");
 	libc_fopen 		= porg_dlsym("fopen");
 	libc_freopen 	= porg_dlsym("freopen");
+	libc_execve 	= porg_dlsym("execve");
+	libc_execv 		= porg_dlsym("execv");
+	libc_execvp 	= porg_dlsym("execvp");
+	libc__exit 		= porg_dlsym("_exit");
+	libc__Exit 		= porg_dlsym("_Exit");
+	libc_close 		= porg_dlsym("close");
+	libc_dup2 		= porg_dlsym("dup2");
+	libc_chdir 		= porg_dlsym("chdir");
+	libc_fchdir 	= porg_dlsym("fchdir");
+
+#ifdef __GLIBC__
+	libc_execvpe 	= porg_dlsym("execvpe");
+	libc_dup3 		= porg_dlsym("dup3");
+#endif
 
 #if HAVE_64_FUNCS
 	libc_open64 	= porg_dlsym("open64");
@@ -174,15 +601,97 @@ static void porg_init()
 }
 
 
+/*
+ * Initialize the library, once. Calls made while this thread is doing it 
+ * (e.g. from dlsym()) return right away.
+ */
+static void porg_init()
+{
+	if (porg_initialized) {
+		__sync_synchronize();
+		return;
+	}
+	else if (porg_initializing)
+		return;
+
+	porg_initializing = 1;
+	pthread_mutex_lock(&porg_init_lock);
+
+	if (!porg_initialized) {
+		porg_init_once();
+		__sync_synchronize();
+		porg_initialized = 1;
+	}
+
+	pthread_mutex_unlock(&porg_init_lock);
+	porg_initializing = 0;
+}
+
+
+/*
+ * Return whether path has already been logged, and remember it otherwise.
+ * Must be called with porg_log_lock held.
+ */
+static int porg_seen(const char* path)
+{
+	uint64_t h = 14695981039346656037ULL;	/* 64-bit FNV-1a */
+	uint64_t* bucket;
+	size_t i;
+
+	for ( ; *path; path++)
+		h = (h ^ (unsigned char)*path) * 1099511628211ULL;
+
+	if (!h)  /* 0 marks empty entries */
+		h = 1;
+
+	bucket = porg_seen_tab + (h & (PORG_SEENSIZE / PORG_SEENWAYS - 1)) * PORG_SEENWAYS;
+
+	for (i = 0; i < PORG_SEENWAYS && bucket[i]; i++) {
+		if (bucket[i] == h)
+			return 1;
+	}
+
+	/* use a free entry, or evict one chosen by the upper bits of the hash */
+	if (i == PORG_SEENWAYS)
+		i = (h >> 32) % PORG_SEENWAYS;
+
+	bucket[i] = h;
+
+	return 0;
+}
+
+
+/*
+ * Add an absolute path to the buffer of records, unless it has already been
+ * logged. Must be called with porg_log_lock held.
+ */
+static int porg_add_record(const char* abs_path)
+{
+	size_t len = strlen(abs_path);
+
+	if (porg_seen(abs_path))
+		return 0;
+
+	if (porg_loglen + len + 1 > PORG_LOGBUFSIZE && porg_write_logbuf() < 0)
+		return -1;
+
+	memcpy(porg_logbuf + porg_loglen, abs_path, len);
+	porg_loglen += len;
+	porg_logbuf[porg_loglen++] = '\n';
+
+	return 0;
+}
+
+
 /*
  * Log a filename to the tmp file, and print a debug message to stderr if 
  * debugging is enabled.
  */
 static void porg_log(const char* path, const char* fmt, ...)
 {
-	static char abs_path[PORG_BUFSIZE];
+	char abs_path[PORG_BUFSIZE];
 	va_list a;
-	int fd, len, old_errno = errno;
+	int old_errno = errno;
 	
 	if (!strncmp(path, "/dev/", 5) || !strncmp(path, "/proc/", 6))
 		return;
@@ -191,39 +700,217 @@ static void porg_log(const char* path, const char* fmt, ...)
 
 	if (porg_debug) {
 		va_start(a, fmt);
-		porg_vprintf(fmt, a);
+		porg_vprintf(0, fmt, a);
 		va_end(a);
 	}
 
-	/* write path to tmp file to be read by porg */
+	/* add path to the buffer of records to be written to the tmp file */
 
-	if ((fd = libc_open(porg_tmpfile, O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0)
-		porg_die("open(\"%s\"): %s", porg_tmpfile, strerror(errno));
-	
 	porg_get_absolute_path(-1, path, abs_path);
-	strncat(abs_path, "\n", PORG_BUFSIZE - strlen(abs_path) - 1);
-	len = strlen(abs_path);
-	
-	if (write(fd, abs_path, len) != len)
+
+	pthread_mutex_lock(&porg_log_lock);
+
+	if (porg_add_record(abs_path) < 0) {
+		pthread_mutex_unlock(&porg_log_lock);
 		porg_die("%s: write(): %s", porg_tmpfile, strerror(errno));
-		
-	if (close(fd) < 0)
-		porg_die("close(%d): %s", fd, strerror(errno));
-	
+	}
+
+	pthread_mutex_unlock(&porg_log_lock);
 	errno = old_errno;
 }
 
 
+/*
+ * Open the directory at t->path for porg_dir_next(), as level d of the walk,
+ * relative to the directory of the level above, if any. Return -1 on error.
+ */
+static int porg_dir_open(struct porg_tree* t, struct porg_dirstream* d)
+{
+	int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW;
+
+#if HAVE_AT_FUNCS
+	if (d > t->dirs)
+		d->fd = libc_openat(d[-1].fd, t->path + d[-1].path_len + 1, flags);
+	else
+#endif
+		d->fd = libc_open(t->path, flags);
+
+	if (d->fd < 0)
+		return -1;
+
+	fcntl(d->fd, F_SETFD, FD_CLOEXEC);
+	d->path_len = strlen(t->path);
+
+#ifdef SYS_getdents64
+	d->off = 0;
+	t->len = t->pos = 0;
+#else
+	if (!(d->dir = fdopendir(d->fd))) {
+		libc_close(d->fd);
+		return -1;
+	}
+#endif
+
+	return 0;
+}
+
+
+/*
+ * Get the name and type (DT_*) of the next entry of the directory d.
+ * Return 0 at the end of the directory.
+ */
+static int porg_dir_next(struct porg_tree* t, struct porg_dirstream* d, 
+	const char** name, int* type)
+{
+#ifdef SYS_getdents64
+	struct porg_dirent64* e;
+
+	if (t->pos >= t->len) {
+		t->len = syscall(SYS_getdents64, d->fd, t->buf, sizeof(t->buf));
+		t->pos = 0;
+		if (t->len <= 0)
+			return 0;
+	}
+
+	e = (struct porg_dirent64*)(t->buf + t->pos);
+	t->pos += e->d_reclen;
+	d->off = e->d_off;
+#else
+	struct dirent* e;
+
+	if (!(e = readdir(d->dir)))
+		return 0;
+#endif
+
+	*name = e->d_name;
+	*type = e->d_type;
+
+	return 1;
+}
+
+
+/*
+ * Go on reading directory d from where it was left, after the buffer has
+ * been used by a subdirectory. Return -1 on error.
+ */
+static int porg_dir_resume(struct porg_tree* t, struct porg_dirstream* d)
+{
+#ifdef SYS_getdents64
+	t->len = t->pos = 0;
+	return lseek(d->fd, d->off, SEEK_SET) < 0 ? -1 : 0;
+#else
+	(void)t;
+	(void)d;
+	return 0;
+#endif
+}
+
+
+static void porg_dir_close(struct porg_dirstream* d)
+{
+#ifdef SYS_getdents64
+	libc_close(d->fd);
+#else
+	closedir(d->dir);
+#endif
+}
+
+
+/*
+ * Log all the files under the directory at the absolute path dir.
+ * The tree is walked depth first, opening each directory relative to its
+ * parent, which is kept open. Memory use does not depend on the number of
+ * files or directories. Subtrees deeper than PORG_TREEDEPTH levels are walked
+ * by a nested call, which opens them by their full path. Files that can't be
+ * logged (unreadable directories, too long paths) are reported to stderr.
+ */
+static void porg_log_tree(const char* dir)
+{
+	struct porg_tree* t;
+	struct porg_dirstream* d;
+	const char* name;
+	size_t name_len;
+	struct stat st;
+	int type, ret = 0;
+
+	if (!(t = malloc(sizeof(*t)))) {
+		porg_error("%s: malloc(): %s", dir, strerror(errno));
+		return;
+	}
+
+	strncpy(t->path, dir, PORG_BUFSIZE - 1);
+	t->path[PORG_BUFSIZE - 1] = 0;
+
+	if (porg_dir_open(t, d = t->dirs) < 0) {
+		porg_error("%s: %s", t->path, strerror(errno));
+		free(t);
+		return;
+	}
+
+	while (d >= t->dirs && !ret) {
+
+		/* end of this directory: go back up */
+		if (!porg_dir_next(t, d, &name, &type)) {
+			porg_dir_close(d);
+			while (--d >= t->dirs && porg_dir_resume(t, d) < 0) {
+				t->path[d->path_len] = 0;
+				porg_error("%s: lseek(): %s", t->path, strerror(errno));
+				porg_dir_close(d);
+			}
+			continue;
+		}
+
+		if (!strcmp(name, ".") || !strcmp(name, ".."))
+			continue;
+
+		if (d->path_len + (name_len = strlen(name)) + 1 >= PORG_BUFSIZE) {
+			t->path[d->path_len] = 0;
+			porg_error("%s/%s: Path too long, not logged", t->path, name);
+			continue;
+		}
+
+		t->path[d->path_len] = '/';
+		memcpy(t->path + d->path_len + 1, name, name_len + 1);
+
+		if (type == DT_UNKNOWN)
+			type = lstat(t->path, &st) < 0 ? DT_UNKNOWN 
+				: S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+
+		if (type != DT_DIR) {
+			pthread_mutex_lock(&porg_log_lock);
+			ret = porg_add_record(t->path);
+			pthread_mutex_unlock(&porg_log_lock);
+		}
+
+		/* each nested call walks PORG_TREEDEPTH more levels of the path */
+		else if (d + 1 == t->dirs + PORG_TREEDEPTH)
+			porg_log_tree(t->path);
+
+		else if (porg_dir_open(t, d + 1) < 0)
+			porg_error("%s: %s", t->path, strerror(errno));
+
+		else
+			d++;
+	}
+
+	/* close the directories still open, after an error */
+	for ( ; d >= t->dirs; d--)
+		porg_dir_close(d);
+
+	free(t);
+
+	if (ret < 0)
+		porg_die("%s: write(): %s", porg_tmpfile, strerror(errno));
+}
+
+
 /* 
- * Handle renaming of directories 
+ * Handle renaming of files and directories 
  */
 static void porg_log_rename(const char* oldpath, const char* newpath)
 {
-	char oldbuf[PORG_BUFSIZE], newbuf[PORG_BUFSIZE];
+	char abs_path[PORG_BUFSIZE];
 	struct stat st;
-	DIR* dir;
-	struct dirent* e;
-	size_t oldlen, newlen;
 	int old_errno = errno;
 
 	/* The newpath file doesn't exist */
@@ -236,36 +923,44 @@ static void porg_log_rename(const char* oldpath, const char* newpath)
 		goto goto_end;
 	}
 
-	/* Make sure we have enough space for the following slashes */
-	oldlen = strlen(oldpath);
-	newlen = strlen(newpath);
-	if (oldlen + 3 > PORG_BUFSIZE || newlen + 3 > PORG_BUFSIZE)
-		goto goto_end;
-
-	strcpy(oldbuf, oldpath);
-	strcpy(newbuf, newpath);
-	oldbuf[oldlen] = newbuf[newlen] = '/';
-	oldbuf[++oldlen] = newbuf[++newlen] = 0;
-
-	if (!(dir = opendir(newbuf)))
-		goto goto_end;
-
-	while ((e = readdir(dir))) {
-		if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
-			continue;
-		strncat(oldbuf, e->d_name, PORG_BUFSIZE - oldlen - 1);
-		strncat(newbuf, e->d_name, PORG_BUFSIZE - newlen - 1);
-		porg_log_rename(oldbuf, newbuf);
-		oldbuf[oldlen] = newbuf[newlen] = 0;
-	}
+	porg_warn("rename(\"%s\", \"%s\")", oldpath, newpath);
 
-	closedir(dir);
+	porg_forget_dirs();
+	porg_get_absolute_path(-1, newpath, abs_path);
+	porg_log_tree(abs_path);
 
 goto_end: 
 	errno = old_errno;
 }
 
 
+/*
+ * Collect the arguments of execl(), execlp() or execle() into a NULL 
+ * terminated array, leaving 'a' right after the terminating NULL. 
+ * Return NULL if out of memory.
+ */
+static char** porg_exec_args(const char* arg, va_list* a)
+{
+	char** argv = NULL;
+	char** aux;
+	size_t n = 0, size = 0;
+
+	for (;;) {
+		if (n == size) {
+			size = size ? 2 * size : 16;
+			if (!(aux = realloc(argv, size * sizeof(char*)))) {
+				free(argv);
+				return NULL;
+			}
+			argv = aux;
+		}
+		if (!(argv[n++] = (char*)arg))
+			return argv;
+		arg = va_arg(*a, const char*);
+	}
+}
+
+
 /************************/
 /* System call handlers */
 /************************/
@@ -278,7 +973,7 @@ int open(const char* path, int flags, ...)
 
 	/* this fixes a bug when the installer program calls jemalloc 
 	   (thanks Masahiro Kasahara) */
-	if (!porg_tmpfile && path && !strncmp(path, "/proc/", 6))
+	if (!porg_initialized && path && !strncmp(path, "/proc/", 6))
 		return __open(path, flags);
 
 	porg_init();
@@ -375,6 +1070,209 @@ FILE* freopen(const char* path, const char* mode, FILE* stream)
 }
 
 
+int execve(const char* path, char* const argv[], char* const envp[])
+{
+	porg_init();
+	porg_flush();
+	
+	return libc_execve(path, argv, envp);
+}
+
+
+int execv(const char* path, char* const argv[])
+{
+	porg_init();
+	porg_flush();
+	
+	return libc_execv(path, argv);
+}
+
+
+int execvp(const char* file, char* const argv[])
+{
+	porg_init();
+	porg_flush();
+	
+	return libc_execvp(file, argv);
+}
+
+
+#ifdef __GLIBC__
+
+int execvpe(const char* file, char* const argv[], char* const envp[])
+{
+	porg_init();
+	porg_flush();
+	
+	return libc_execvpe(file, argv, envp);
+}
+
+#endif
+
+
+int execl(const char* path, const char* arg, ...)
+{
+	va_list a;
+	char** argv;
+	int ret;
+
+	porg_init();
+	porg_flush();
+
+	va_start(a, arg);
+	argv = porg_exec_args(arg, &a);
+	va_end(a);
+
+	if (!argv) {
+		errno = ENOMEM;
+		return -1;
+	}
+	
+	ret = libc_execv(path, argv);
+	free(argv);
+	return ret;
+}
+
+
+int execlp(const char* file, const char* arg, ...)
+{
+	va_list a;
+	char** argv;
+	int ret;
+
+	porg_init();
+	porg_flush();
+
+	va_start(a, arg);
+	argv = porg_exec_args(arg, &a);
+	va_end(a);
+
+	if (!argv) {
+		errno = ENOMEM;
+		return -1;
+	}
+	
+	ret = libc_execvp(file, argv);
+	free(argv);
+	return ret;
+}
+
+
+int execle(const char* path, const char* arg, ...)
+{
+	va_list a;
+	char** argv;
+	char** envp;
+	int ret;
+
+	porg_init();
+	porg_flush();
+
+	va_start(a, arg);
+	argv = porg_exec_args(arg, &a);
+	envp = argv ? va_arg(a, char**) : NULL;
+	va_end(a);
+
+	if (!argv) {
+		errno = ENOMEM;
+		return -1;
+	}
+	
+	ret = libc_execve(path, argv, envp);
+	free(argv);
+	return ret;
+}
+
+
+int close(int fd)
+{
+	/* don't go through porg_init(), since close() may be called very early
+	   by some allocators */
+	if (!libc_close)
+		libc_close = porg_dlsym("close");
+
+	porg_forget_fd(fd);
+	
+	return libc_close(fd);
+}
+
+
+int dup2(int oldfd, int newfd)
+{
+	int ret;
+
+	porg_init();
+	
+	if ((ret = libc_dup2(oldfd, newfd)) != -1)
+		porg_forget_fd(newfd);
+
+	return ret;
+}
+
+
+#ifdef __GLIBC__
+
+int dup3(int oldfd, int newfd, int flags)
+{
+	int ret;
+
+	porg_init();
+	
+	if ((ret = libc_dup3(oldfd, newfd, flags)) != -1)
+		porg_forget_fd(newfd);
+
+	return ret;
+}
+
+#endif
+
+
+int chdir(const char* path)
+{
+	int ret;
+
+	porg_init();
+	
+	if ((ret = libc_chdir(path)) != -1)
+		porg_forget_cwd();
+
+	return ret;
+}
+
+
+int fchdir(int fd)
+{
+	int ret;
+
+	porg_init();
+	
+	if ((ret = libc_fchdir(fd)) != -1)
+		porg_forget_cwd();
+
+	return ret;
+}
+
+
+void _exit(int status)
+{
+	porg_init();
+	porg_flush();
+	
+	libc__exit(status);
+	abort();  /* not reached */
+}
+
+
+void _Exit(int status)
+{
+	porg_init();
+	porg_flush();
+	
+	libc__Exit(status);
+	abort();  /* not reached */
+}
+
+
 #if HAVE_64_FUNCS
 
 int open64(const char* path, int flags, ...)
@@ -382,7 +1280,7 @@ int open64(const char* path, int flags, ...)
 	va_list a;
 	int mode, accmode, ret;
 	
-	if (!porg_tmpfile && path && !strncmp(path, "/proc/", 6))
+	if (!porg_initialized && path && !strncmp(path, "/proc/", 6))
 		return __open64(path, flags);
 
 	porg_init();
@@ -450,7 +1348,7 @@ int openat(int fd, const char* path, int flags, ...)
 {
 	va_list a;
 	int mode, accmode, ret;
-	static char abs_path[PORG_BUFSIZE];
+	char abs_path[PORG_BUFSIZE];
 
 	porg_init();
 	
@@ -473,8 +1371,8 @@ int openat(int fd, const char* path, int flags, ...)
 int renameat(int oldfd, const char* oldpath, int newfd, const char* newpath)
 {
 	int ret;
-	static char old_abs_path[PORG_BUFSIZE];
-	static char new_abs_path[PORG_BUFSIZE];
+	char old_abs_path[PORG_BUFSIZE];
+	char new_abs_path[PORG_BUFSIZE];
 	
 	porg_init();
 
@@ -492,7 +1390,7 @@ int linkat(int oldfd, const char* oldpath,
            int newfd, const char* newpath, int flags)
 {
 	int ret;
-	static char new_abs_path[PORG_BUFSIZE];
+	char new_abs_path[PORG_BUFSIZE];
 	
 	porg_init();
 
@@ -509,7 +1407,7 @@ int linkat(int oldfd, const char* oldpath,
 int symlinkat(const char* oldpath, int newfd, const char* newpath)
 {
 	int ret;
-	static char new_abs_path[PORG_BUFSIZE];
+	char new_abs_path[PORG_BUFSIZE];
 	
 	porg_init();
 	
@@ -531,7 +1429,7 @@ int openat64(int fd, const char* path, int flags, ...)
 {
 	va_list a;
 	int mode, accmode, ret;
-	static char abs_path[PORG_BUFSIZE];
+	char abs_path[PORG_BUFSIZE];
 
 	porg_init();
 	
@@ -0,0 +1,308 @@
+/***********************************************************************
+ * stress.c: Stress test of libporg-log: logs files from many threads
+ *           at once, and checks that each one is logged exactly once.
+ ***********************************************************************
+ * This file is part of the package porg
+ * Copyright (C) 2015 David Ricart
+ * For more information visit https://jbrubake.github.io/porg
+ ***********************************************************************
+ * Usage: porg-log-stress LIBPORG-LOG
+ *
+ * Runs itself again with LIBPORG-LOG preloaded. Every thread creates its
+ * own files with open(), rename(), openat() on a shared directory (opening
+ * and closing its descriptor from time to time) and fopen(), while one of
+ * them forks children that create files too. Then the records left in the
+ * tmp file are compared with the files created: a lost, duplicated or torn
+ * record makes the test fail.
+ ***********************************************************************/
+
+#include "config.h"
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define STRESS_THREADS  16
+#define STRESS_ITERS  1000
+#define STRESS_FORK_EVERY  100
+#define STRESS_DIRFD_EVERY  50
+#define STRESS_BUFSIZE  4096
+
+static const char* stress_dir;
+static pthread_mutex_t stress_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stress_cond = PTHREAD_COND_INITIALIZER;
+static int stress_go;
+
+
+static void stress_die(const char* fmt, const char* arg)
+{
+	fprintf(stderr, "porg-log-stress: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, ": %s\n", strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+
+/*
+ * Create the file at path with open(), and close it
+ */
+static void stress_touch(int dirfd, const char* path)
+{
+	int fd = dirfd < 0 ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)
+		: openat(dirfd, path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0)
+		stress_die("open(\"%s\")", path);
+
+	close(fd);
+}
+
+
+static void* stress_thread(void* arg)
+{
+	char path[STRESS_BUFSIZE], path2[STRESS_BUFSIZE];
+	long t = (long)arg;
+	int i, dirfd = -1;
+	pid_t pid;
+	FILE* f;
+
+	/* start all the threads at once, so that they race to initialize */
+	pthread_mutex_lock(&stress_lock);
+	while (!stress_go)
+		pthread_cond_wait(&stress_cond, &stress_lock);
+	pthread_mutex_unlock(&stress_lock);
+
+	for (i = 0; i < STRESS_ITERS; i++) {
+
+		snprintf(path, sizeof(path), "%s/o%ld_%d", stress_dir, t, i);
+		snprintf(path2, sizeof(path2), "%s/r%ld_%d", stress_dir, t, i);
+		stress_touch(-1, path);
+		if (rename(path, path2) < 0)
+			stress_die("rename(\"%s\")", path);
+
+		if (i % STRESS_DIRFD_EVERY == 0) {
+			if (dirfd >= 0)
+				close(dirfd);
+			snprintf(path, sizeof(path), "%s/sub", stress_dir);
+			if ((dirfd = open(path, O_RDONLY | O_DIRECTORY)) < 0)
+				stress_die("open(\"%s\")", path);
+		}
+
+		snprintf(path, sizeof(path), "a%ld_%d", t, i);
+		stress_touch(dirfd, path);
+
+		snprintf(path, sizeof(path), "%s/f%ld_%d", stress_dir, t, i);
+		if (!(f = fopen(path, "w")))
+			stress_die("fopen(\"%s\")", path);
+		fclose(f);
+
+		if (t == 0 && i % STRESS_FORK_EVERY == 0) {
+			snprintf(path, sizeof(path), "%s/k%d", stress_dir, i);
+			if ((pid = fork()) == 0) {
+				stress_touch(-1, path);
+				_exit(EXIT_SUCCESS);
+			}
+			else if (pid < 0 || waitpid(pid, NULL, 0) < 0)
+				stress_die("fork(): %s", path);
+		}
+	}
+
+	if (dirfd >= 0)
+		close(dirfd);
+
+	return NULL;
+}
+
+
+/*
+ * Body of the preloaded process
+ */
+static int stress_run()
+{
+	pthread_t th[STRESS_THREADS];
+	long t;
+
+	for (t = 0; t < STRESS_THREADS; t++) {
+		if ((errno = pthread_create(th + t, NULL, stress_thread, (void*)t)))
+			stress_die("%s", "pthread_create()");
+	}
+
+	pthread_mutex_lock(&stress_lock);
+	stress_go = 1;
+	pthread_cond_broadcast(&stress_cond);
+	pthread_mutex_unlock(&stress_lock);
+
+	for (t = 0; t < STRESS_THREADS; t++)
+		pthread_join(th[t], NULL);
+
+	return EXIT_SUCCESS;
+}
+
+
+static int stress_cmp(const void* a, const void* b)
+{
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+
+/*
+ * Get the paths of the files created by stress_run(), sorted.
+ * Return their number.
+ */
+static size_t stress_expected(char*** paths)
+{
+	size_t n = 0, max = STRESS_THREADS * STRESS_ITERS * 4 + STRESS_ITERS;
+	char buf[STRESS_BUFSIZE];
+	long t;
+	int i;
+
+	if (!(*paths = malloc(max * sizeof(char*))))
+		stress_die("%s", "malloc()");
+
+	for (t = 0; t < STRESS_THREADS; t++) {
+		for (i = 0; i < STRESS_ITERS; i++) {
+			snprintf(buf, sizeof(buf), "%s/o%ld_%d", stress_dir, t, i);
+			(*paths)[n++] = strdup(buf);
+			snprintf(buf, sizeof(buf), "%s/r%ld_%d", stress_dir, t, i);
+			(*paths)[n++] = strdup(buf);
+			snprintf(buf, sizeof(buf), "%s/sub/a%ld_%d", stress_dir, t, i);
+			(*paths)[n++] = strdup(buf);
+			snprintf(buf, sizeof(buf), "%s/f%ld_%d", stress_dir, t, i);
+			(*paths)[n++] = strdup(buf);
+		}
+	}
+
+	for (i = 0; i < STRESS_ITERS; i += STRESS_FORK_EVERY) {
+		snprintf(buf, sizeof(buf), "%s/k%d", stress_dir, i);
+		(*paths)[n++] = strdup(buf);
+	}
+
+	qsort(*paths, n, sizeof(char*), stress_cmp);
+	return n;
+}
+
+
+/*
+ * Read the records of the tmp file, sorted. Return their number.
+ */
+static size_t stress_logged(const char* tmpfile, char*** paths)
+{
+	char buf[STRESS_BUFSIZE];
+	size_t n = 0, max = 1024, len;
+	FILE* f;
+
+	if (!(f = fopen(tmpfile, "r")))
+		stress_die("fopen(\"%s\")", tmpfile);
+
+	if (!(*paths = malloc(max * sizeof(char*))))
+		stress_die("%s", "malloc()");
+
+	while (fgets(buf, sizeof(buf), f)) {
+		if ((len = strlen(buf)) && buf[len - 1] == '\n')
+			buf[len - 1] = 0;
+		if (n == max && !(*paths = realloc(*paths, (max *= 2) * sizeof(char*))))
+			stress_die("%s", "realloc()");
+		(*paths)[n++] = strdup(buf);
+	}
+
+	fclose(f);
+	qsort(*paths, n, sizeof(char*), stress_cmp);
+	return n;
+}
+
+
+static int stress_rm(const char* path, const struct stat* st, int type, struct FTW* ftw)
+{
+	(void)st;
+	(void)type;
+	(void)ftw;
+	return remove(path);
+}
+
+
+int main(int argc, char* argv[])
+{
+	char dir[STRESS_BUFSIZE / 2], tmpfile[STRESS_BUFSIZE];
+	char** expected;
+	char** logged;
+	size_t nexp, nlog, i = 0, j = 0, errors = 0;
+	const char* tmpdir = getenv("TMPDIR");
+	int status, cmp;
+	pid_t pid;
+
+	if (argc == 3 && !strcmp(argv[1], "--run")) {
+		stress_dir = argv[2];
+		return stress_run();
+	}
+
+	else if (argc != 2) {
+		fprintf(stderr, "Usage: porg-log-stress LIBPORG-LOG\n");
+		return EXIT_FAILURE;
+	}
+
+	snprintf(dir, sizeof(dir), "%s/porg-stressXXXXXX", tmpdir ? tmpdir : "/tmp");
+	if (!mkdtemp(dir))
+		stress_die("mkdtemp(\"%s\")", dir);
+
+	stress_dir = dir;
+	snprintf(tmpfile, sizeof(tmpfile), "%s/sub", dir);
+	if (mkdir(tmpfile, 0755) < 0)
+		stress_die("mkdir(\"%s\")", tmpfile);
+
+	/* the tmp file is not under the directory, so that it's not logged */
+	snprintf(tmpfile, sizeof(tmpfile), "%s.log", dir);
+
+	if ((pid = fork()) == 0) {
+		setenv("PORG_TMPFILE", tmpfile, 1);
+#ifdef __APPLE__
+		setenv("DYLD_INSERT_LIBRARIES", argv[1], 1);
+		setenv("DYLD_FORCE_FLAT_NAMESPACE", "1", 1);
+#else
+		setenv("LD_PRELOAD", argv[1], 1);
+#endif
+		execl(argv[0], argv[0], "--run", dir, (char*)NULL);
+		stress_die("execl(\"%s\")", argv[0]);
+	}
+
+	else if (pid < 0 || waitpid(pid, &status, 0) < 0)
+		stress_die("%s", "fork()");
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+		fprintf(stderr, "porg-log-stress: preloaded process failed\n");
+		return EXIT_FAILURE;
+	}
+
+	nexp = stress_expected(&expected);
+	nlog = stress_logged(tmpfile, &logged);
+
+	/* both lists are sorted */
+	while (i < nexp || j < nlog) {
+
+		cmp = i == nexp ? 1 : j == nlog ? -1 : strcmp(expected[i], logged[j]);
+
+		if (cmp < 0)
+			fprintf(stderr, "porg-log-stress: not logged: %s\n", expected[i++]);
+		else if (cmp > 0)
+			fprintf(stderr, "porg-log-stress: unexpected record: %s\n", logged[j++]);
+		else if (j + 1 < nlog && !strcmp(logged[j], logged[j + 1]))
+			fprintf(stderr, "porg-log-stress: logged twice: %s\n", logged[j++]);
+		else {
+			i++;
+			j++;
+			continue;
+		}
+
+		if (++errors == 20)
+			break;
+	}
+
+	nftw(dir, stress_rm, 16, FTW_DEPTH | FTW_PHYS);
+	unlink(tmpfile);
+
+	if (errors)
+		return EXIT_FAILURE;
+
+	printf("porg-log-stress: %lu files logged by %d threads\n", (unsigned long)nexp, STRESS_THREADS);
+	return EXIT_SUCCESS;
+}
@@ -22,6 +22,7 @@ string BaseOpt::s_logdir		= LOGDIR;
 string BaseOpt::s_include		= "/";
 string BaseOpt::s_exclude		= EXCLUDE;
 string BaseOpt::s_remove_skip	= "";
+bool BaseOpt::s_binary_log		= false;
 
 
 BaseOpt::BaseOpt()
@@ -48,6 +49,8 @@ BaseOpt::BaseOpt()
    				s_exclude = val;
 			else if (opt == "remove_skip")
    				s_remove_skip = val;
+			else if (opt == "log_format")
+				s_binary_log = (Porg::to_lower(val) == "binary");
 		}
 	}
 }
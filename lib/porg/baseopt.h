@@ -25,6 +25,7 @@ class BaseOpt
 	static std::string const& include()		{ return s_include; }
 	static std::string const& exclude()		{ return s_exclude; }
 	static std::string const& remove_skip()	{ return s_remove_skip; }
+	static bool binary_log()				{ return s_binary_log; }
 	
 	static bool logdir_writable();
 
@@ -37,6 +38,7 @@ class BaseOpt
 	static std::string s_include;
 	static std::string s_exclude;
 	static std::string s_remove_skip;
+	static bool s_binary_log;
 
 };	// class BaseOpt
 
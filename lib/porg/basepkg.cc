@@ -10,18 +10,25 @@
 #include "basepkg.h"
 #include "baseopt.h"
 #include "file.h"
+#include "index.h"
+#include "binlog.h"
 #include <fstream>
 #include <algorithm>
 #include <sstream>
-#include <iomanip>
 
 using std::string;
 using namespace Porg;
 
+static float parse_size(char const*, char const*);
+
 
 BasePkg::BasePkg(string const& name_)
 :
 	m_files(),
+	m_binlog(0),
+	m_binary_log(false),
+	m_files_pending(false),
+	m_header_pending(false),
 	m_inodes(),
 	m_name(name_),
 	m_log(BaseOpt::logdir() + "/" + name_),
@@ -51,23 +58,24 @@ void BasePkg::read_info_line(string const& buf)
 {
 	assert(buf.size() > 2 && buf[0] == '#' && buf[2] == ':');
 
-	string val(buf.substr(3));
+	char const* val = buf.data() + 3;
+	char const* end = buf.data() + buf.size();
 
 	switch (buf[1]) {
 
-		case CODE_DATE: 		m_date = str2num<int>(val);		break;
-		case CODE_SIZE: 		m_size = str2num<float>(val);	break;
-		case CODE_NFILES: 		m_nfiles = str2num<ulong>(val);	break;
-		case CODE_CONF_OPTS:	m_conf_opts = val; 				break;
-		case CODE_ICON_PATH:	m_icon_path = val;				break;
-		case CODE_SUMMARY: 		m_summary = val; 				break;
-		case CODE_URL: 			m_url = val; 					break;
-		case CODE_LICENSE: 		m_license = val; 				break;
-		case CODE_AUTHOR: 		m_author = val;					break;
+		case CODE_DATE: 		parse_num(val, end, m_date);		break;
+		case CODE_SIZE: 		m_size = parse_size(val, end);		break;
+		case CODE_NFILES: 		parse_num(val, end, m_nfiles);		break;
+		case CODE_CONF_OPTS:	m_conf_opts.assign(val, end); 		break;
+		case CODE_ICON_PATH:	m_icon_path.assign(val, end);		break;
+		case CODE_SUMMARY: 		m_summary.assign(val, end); 		break;
+		case CODE_URL: 			m_url.assign(val, end); 			break;
+		case CODE_LICENSE: 		m_license.assign(val, end); 		break;
+		case CODE_AUTHOR: 		m_author.assign(val, end);			break;
 		case CODE_DESCRIPTION:
 			if (!m_description.empty())
 				m_description += "\n";
-			m_description += val;
+			m_description.append(val, end);
 			break;
 		
 		default: assert(false); break;
@@ -75,46 +83,191 @@ void BasePkg::read_info_line(string const& buf)
 }
 	
 
-void BasePkg::read_log()
+//
+// Read the info lines in @info, separated by newlines
+//
+void BasePkg::read_info(string const& info)
+{
+	std::istringstream is(info);
+
+	for (string buf; getline(is, buf); ) {
+		if (buf.size() > 2 && buf[0] == '#' && buf[2] == ':')
+			read_info_line(buf);
+	}
+}
+
+
+//
+// Read the log of the package.
+// If @header_only is set, only the info header is read, and the list of
+// files is read later, when it's first needed (see read_files()).
+//
+void BasePkg::read_log(bool header_only /* = false */)
 {
+	// binary logs are mapped into memory, and the list of files is read
+	// in place (see load_files())
+
+	if (BinLog::is_binlog(m_log)) {
+		m_binary_log = true;
+		m_sorted_by_name = true;
+		m_files_pending = header_only;
+		if (header_only)
+			read_info(BinLog::read_info(m_log));
+		else {
+			m_binlog = new BinLog(m_log);
+			read_info(m_binlog->info());
+		}
+		return;
+	}
+
 	FileStream<std::ifstream> f(m_log);
 	string buf;
 	
 	if (!(getline(f, buf) && buf.find("#!porg") == 0))
 		throw Error(m_log + ": '#!porg' header missing");
 
-	char path[4096], link_path[4096];
-	ulong size;
+	// the info header comes before the list of files
+	while (getline(f, buf) && buf[0] == '#')
+		read_info_line(buf);
 
-	while (getline(f, buf)) {
-
-		switch (sscanf(buf.c_str(), "%[^|]|%lu|%s", path, &size, link_path)) {
-
-			case 1:	// info header
-				read_info_line(buf);
-				break;
-			
-			case 2: // regular file
-				m_files.push_back(new File(path, size)); 
-				break;
-			
-			case 3: // symlink
-				m_files.push_back(new File(path, size, link_path)); 
-				break;
-			
-			default: // parse error
-				assert(false);
-				break;
-		}
+	if (header_only) {
+		m_files_pending = true;
+		return;
+	}
+
+	if (f) {
+		do
+			read_file_line(buf);
+		while (getline(f, buf));
 	}
 
 	sort_files();
 }
 
 
+//
+// Get the fields of the header from the entry @e of the catalog. The rest of
+// the header is not read until load_header() is called, and the list of
+// files until it's needed.
+//
+void BasePkg::read_catalog(Catalog::Entry const& e)
+{
+	m_binary_log = e.binary;
+	m_sorted_by_name = e.binary;
+	m_files_pending = true;
+	m_header_pending = true;
+	m_date = e.date;
+	m_size = e.size;
+	m_nfiles = e.nfiles;
+	m_summary = e.summary;
+}
+
+
+//
+// Read the whole header of a package read from the catalog
+//
+void BasePkg::load_header()
+{
+	if (!m_header_pending)
+		return;
+
+	m_header_pending = false;
+
+	if (m_binary_log) {
+		read_info(BinLog::read_info(m_log));
+		return;
+	}
+
+	FileStream<std::ifstream> f(m_log);
+	string buf;
+
+	if (!(getline(f, buf) && buf.find("#!porg") == 0))
+		throw Error(m_log + ": '#!porg' header missing");
+
+	while (getline(f, buf) && buf[0] == '#') {
+		if (buf.size() > 2 && buf[2] == ':')
+			read_info_line(buf);
+	}
+}
+
+
+//
+// Parse a line of the list of files of a text log, of the form
+// '<path>|<size>|<symlink contents>'
+//
+void BasePkg::read_file_line(string const& buf) const
+{
+	char const* p = buf.data();
+	char const* end = p + buf.size();
+	char const* sep = static_cast<char const*>(memchr(p, '|', end - p));
+	ulong size;
+
+	// parse error (or empty list of files)
+	if (!sep || sep == p || parse_num(sep + 1, end, size) == sep + 1)
+		return;
+
+	string path(p, sep);
+	char const* link = parse_num(sep + 1, end, size);
+
+	if (link < end && *link == '|' && ++link < end)
+		m_files.push_back(new File(path, size, string(link, end)));
+	else
+		m_files.push_back(new File(path, size));
+}
+
+
+//
+// Read the list of files, if it was skipped by read_log(), either mapping
+// the binary log into memory or parsing the text one.
+//
+void BasePkg::read_files() const
+{
+	if (!m_files_pending)
+		return;
+
+	m_files_pending = false;
+
+	if (m_binary_log) {
+		m_binlog = new BinLog(m_log);
+		return;
+	}
+
+	FileStream<std::ifstream> f(m_log);
+	
+	for (string buf; getline(f, buf); ) {
+		if (buf[0] != '#')
+			read_file_line(buf);
+	}
+
+	std::sort(m_files.begin(), m_files.end(), Sorter());
+	m_sorted_by_name = true;
+}
+
+
+//
+// Create the list of files from the binary log, if not done yet
+//
+void BasePkg::load_files() const
+{
+	read_files();
+
+	if (!m_binlog)
+		return;
+
+	m_files.reserve(m_files.size() + m_binlog->nfiles());
+
+	for (size_t i = 0; i < m_binlog->nfiles(); ++i)
+		m_files.push_back(m_binlog->file(i));
+
+	delete m_binlog;
+	m_binlog = 0;
+}
+
+
 BasePkg::~BasePkg()
 {
 	for (iter f(m_files.begin()); f != m_files.end(); delete *f++) ;
+	delete m_binlog;
 }
 
 
@@ -122,6 +275,9 @@ void BasePkg::unlog() const
 {
 	if (unlink(m_log.c_str()) != 0 && errno != ENOENT)
 		throw Error("unlink(" + m_log + ")", errno);
+
+	Index::remove(m_name);
+	Catalog::remove(m_name);
 }
 
 
@@ -159,36 +315,84 @@ string BasePkg::format_description() const
 }
 
 
+//
+// Info header of the log, made up of '#<char>:<value>' lines
+//
+string BasePkg::info_str() const
+{
+	string info;
+	string const summary(Porg::strip_trailing(m_summary, '.'));
+	char buf[NUM_BUFSIZE];
+
+	auto add = [&info](char code, char const* val, size_t len) {
+		info.append(1, '#').append(1, code).append(1, ':').append(val, len).append(1, '\n');
+	};
+
+	// sizes are whole numbers of bytes
+	add(CODE_DATE,		buf, format_num(buf, m_date));
+	add(CODE_SIZE,		buf, format_num(buf, ulong(m_size)));
+	add(CODE_NFILES,	buf, format_num(buf, m_nfiles));
+	add(CODE_AUTHOR,	m_author.data(), m_author.size());
+	add(CODE_SUMMARY,	summary.data(), summary.size());
+	add(CODE_URL,		m_url.data(), m_url.size());
+	add(CODE_LICENSE,	m_license.data(), m_license.size());
+	add(CODE_CONF_OPTS,	m_conf_opts.data(), m_conf_opts.size());
+	add(CODE_ICON_PATH,	m_icon_path.data(), m_icon_path.size());
+
+	return info + format_description();
+}
+
+
 void BasePkg::write_log() const
 {
-	// Create log file
+	write_log(BaseOpt::binary_log());
+}
 
-	FileStream<std::ofstream> of(m_log);
 
-	// write info header
+//
+// Write the log in binary or text format.
+// The log is written into a temporary file which then replaces the old log,
+// because the old one may be still mapped into memory.
+//
+void BasePkg::write_log(bool binary) const
+{
+	// the whole header is needed
+	assert(!m_header_pending);
 
-	of	<< "#!porg-" PACKAGE_VERSION "\n"
-		<< '#' << CODE_DATE 		<< ':' << m_date << '\n'
-		<< '#' << CODE_SIZE 		<< ':' << std::setprecision(0) << std::fixed << m_size << '\n'
-		<< '#' << CODE_NFILES       << ':' << m_nfiles << '\n'
-		<< '#' << CODE_AUTHOR		<< ':' << m_author << '\n'
-		<< '#' << CODE_SUMMARY		<< ':' << Porg::strip_trailing(m_summary, '.') << '\n'
-		<< '#' << CODE_URL			<< ':' << m_url << '\n'
-		<< '#' << CODE_LICENSE		<< ':' << m_license << '\n'
-		<< '#' << CODE_CONF_OPTS	<< ':' << m_conf_opts << '\n'
-		<< '#' << CODE_ICON_PATH	<< ':' << m_icon_path << '\n'
-		<< format_description();
+	load_files();
 
-	// write installed files
-	
-	for (const_iter f(m_files.begin()); f != m_files.end(); ++f)
-		of << (*f)->name() << '|' << (*f)->size() << '|' << (*f)->ln_name() << '\n';
+	AtomicStream of(m_log);
+
+	if (binary)
+		BinLog::write(of, info_str(), m_files);
+
+	else {
+		of << "#!porg-" PACKAGE_VERSION "\n" << info_str();
+
+		char size[NUM_BUFSIZE];
+
+		for (const_iter f(m_files.begin()); f != m_files.end(); ++f) {
+			of.write((*f)->name().data(), (*f)->name().size());
+			of.put('|');
+			of.write(size, format_num(size, (*f)->size()));
+			of.put('|');
+			of.write((*f)->ln_name().data(), (*f)->ln_name().size());
+			of.put('\n');
+		}
+	}
+
+	of.commit();
+
+	Index::update(*this);
+	Catalog::update(*this);
 }
 
 
-void BasePkg::log_file(string const& path)
+void BasePkg::log_file(File const& file_)
 {
-	File* file = new File(path);
+	load_files();
+
+	File* file = new File(file_);
 	m_files.push_back(file);
 
 	m_nfiles++;
@@ -208,6 +412,11 @@ bool BasePkg::find_file(File* file)
 {
 	assert(file != NULL);
 
+	read_files();
+
+	if (m_binlog)
+		return m_binlog->find(file->name());
+
 	if (!m_sorted_by_name)
 		sort_files();
 	
@@ -217,6 +426,11 @@ bool BasePkg::find_file(File* file)
 
 bool BasePkg::find_file(string const& path)
 {
+	read_files();
+
+	if (m_binlog)
+		return m_binlog->find(path);
+
 	File file(path);
 	return find_file(&file);
 }
@@ -225,6 +439,8 @@ bool BasePkg::find_file(string const& path)
 void BasePkg::sort_files(	sort_t type,	// = SORT_BY_NAME
 							bool reverse)	// = false
 {
+	load_files();
+
 	std::sort(m_files.begin(), m_files.end(), Sorter(type));
 	
 	if (reverse)
@@ -282,3 +498,21 @@ inline bool BasePkg::Sorter::sort_by_size(File* left, File* right) const
 	return left->size() > right->size();
 }
 
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+//
+// Parse the size in the header of a log. It's written with no decimals
+// (see info_str()), but logs written by older versions may have them.
+//
+static float parse_size(char const* p, char const* end)
+{
+	ulong size = 0;
+	char const* q = parse_num(p, end, size);
+
+	return q == end ? size : str2num<float>(string(p, end));
+}
+
@@ -11,6 +11,7 @@
 
 #include "config.h"
 #include "common.h"
+#include "catalog.h"
 #include <iosfwd>
 #include <vector>
 #include <set>
@@ -19,6 +20,7 @@
 namespace Porg {
 
 class File;
+class BinLog;
 
 class BasePkg
 {
@@ -42,7 +44,7 @@ class BasePkg
 	BasePkg(std::string const& name_);
 	virtual ~BasePkg();
 
-	std::vector<File*> const& files() const	{ return m_files; }
+	std::vector<File*> const& files() const	{ load_files(); return m_files; }
 	int date() const						{ return m_date; }
 	float size() const						{ return m_size; }
 	ulong nfiles() const					{ return m_nfiles; }
@@ -58,34 +60,44 @@ class BasePkg
 	std::string const& conf_opts() const	{ return m_conf_opts; }
 	std::string const& author() const		{ return m_author; }
 
+	bool is_binary_log() const				{ return m_binary_log; }
+
 	bool find_file(File*);
 	bool find_file(std::string const& path);
 	virtual void unlog() const;
 	void write_log() const;
-	void read_log();
+	void write_log(bool binary) const;
+	void read_log(bool header_only = false);
+	void read_catalog(Catalog::Entry const&);
+	void load_header();
 	
 	static std::string get_base(std::string const& name);
 	static std::string get_version(std::string const& name);
 
-	template <typename T>	// T = {Pkg,BasePkg}
-	bool is_shared(File* file, std::vector<T*> const& pkgs) const
-	{
-		for (typename std::vector<T*>::const_iterator p(pkgs.begin()); p != pkgs.end(); ++p) {
-			if ((*p)->name() != m_name && (*p)->find_file(file))
-				return true;
-		}
-		return false;
-	}
-
 	protected:
 
 	void read_info_line(std::string const&);
+	void read_info(std::string const&);
+	void read_file_line(std::string const&) const;
+	void read_files() const;
+	void load_files() const;
+	std::string info_str() const;
 	void sort_files(sort_t type = SORT_BY_NAME, bool reverse = false);
 	std::string format_description() const;
-	void log_file(std::string const& path);
+	void log_file(File const&);
 	std::string description_str(bool debug = false) const;
 
-	std::vector<File*> m_files;
+	// For binary logs, m_files is filled from m_binlog the first time that
+	// the list of files is needed.
+	// If only the header of the log has been read, m_files_pending is set
+	// until the list of files is read (into m_files or m_binlog).
+	// If the package was read from the catalog, m_header_pending is set
+	// until the rest of the header is read by load_header().
+	mutable std::vector<File*> m_files;
+	mutable BinLog* m_binlog;
+	bool m_binary_log;
+	mutable bool m_files_pending;
+	bool m_header_pending;
 	std::set<ino_t> m_inodes;
 	std::string const m_name;
 	std::string const m_log;
@@ -101,7 +113,7 @@ class BasePkg
 	std::string m_description;
 	std::string m_conf_opts;
 	std::string m_author;
-	bool m_sorted_by_name;
+	mutable bool m_sorted_by_name;
 
 	class Sorter
 	{
@@ -0,0 +1,228 @@
+//=======================================================================
+// binlog.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#include "config.h"
+#include "binlog.h"
+#include "common.h"
+#include "file.h"
+#include <algorithm>
+#include <fcntl.h>
+
+using std::string;
+using std::vector;
+using namespace Porg;
+
+char const BinLog::MAGIC[8] = { '\177', 'p', 'o', 'r', 'g', 'b', 'i', 'n' };
+
+static size_t align8(size_t);
+static int compare_name(char const*, size_t, string const&);
+static bool name_less(File*, File*);
+
+
+BinLog::BinLog(string const& path)
+:
+	m_map(path),
+	m_header(reinterpret_cast<Header const*>(m_map.begin())),
+	m_info(0),
+	m_records(0),
+	m_strings(0)
+{
+	size_t size = m_map.size();
+
+	if (size < sizeof(Header) || memcmp(m_header->magic, MAGIC, sizeof(MAGIC)))
+		throw Error(path + ": Not a binary porg log");
+
+	if (m_header->version != FORMAT_VERSION)
+		throw Error(path + ": Unsupported binary log version");
+
+	// check that all sections fit into the file
+
+	size_t off = sizeof(Header) + align8(m_header->info_len);
+
+	if (m_header->info_len > size || off > size
+	|| m_header->nfiles > (size - off) / sizeof(Record)
+	|| m_header->strings_len != size - off - m_header->nfiles * sizeof(Record))
+		throw Error(path + ": Corrupt binary log");
+
+	m_info = m_map.begin() + sizeof(Header);
+	m_records = reinterpret_cast<Record const*>(m_map.begin() + off);
+	m_strings = reinterpret_cast<char const*>(m_records + m_header->nfiles);
+
+	for (size_t i = 0; i < m_header->nfiles; ++i) {
+		Record const& r = m_records[i];
+		if (r.name_off >= m_header->strings_len
+		|| r.name_len >= m_header->strings_len - r.name_off
+		|| r.ln_name_off >= m_header->strings_len
+		|| r.ln_name_len >= m_header->strings_len - r.ln_name_off)
+			throw Error(path + ": Corrupt binary log");
+	}
+}
+
+
+//
+// Create a File for the i-th record
+//
+File* BinLog::file(size_t i) const
+{
+	Record const& r = m_records[i];
+	return new File(string(name(r), r.name_len), r.size,
+		string(ln_name(r), r.ln_name_len));
+}
+
+
+//
+// Binary search @path among the records
+//
+bool BinLog::find(string const& path) const
+{
+	size_t lo = 0, hi = m_header->nfiles;
+
+	while (lo < hi) {
+
+		size_t mid = lo + (hi - lo) / 2;
+		Record const& r = m_records[mid];
+		int cmp = compare_name(name(r), r.name_len, path);
+
+		if (!cmp)
+			return true;
+		else if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return false;
+}
+
+
+bool BinLog::is_binlog(string const& path)
+{
+	char magic[sizeof(MAGIC)];
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	bool ret = read(fd, magic, sizeof(magic)) == sizeof(magic)
+		&& !memcmp(magic, MAGIC, sizeof(MAGIC));
+
+	close(fd);
+	return ret;
+}
+
+
+//
+// Read only the info header of the binary log @path, without mapping it
+//
+string BinLog::read_info(string const& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw Error(path, errno);
+
+	Header header;
+	struct stat s;
+	string info;
+	bool ok = !fstat(fd, &s)
+		&& read(fd, &header, sizeof(header)) == sizeof(header)
+		&& !memcmp(header.magic, MAGIC, sizeof(MAGIC))
+		&& header.version == FORMAT_VERSION
+		&& header.info_len <= s.st_size - sizeof(header);
+
+	if (ok) {
+		info.resize(header.info_len);
+		ok = pread(fd, &info[0], info.size(), sizeof(header)) == ssize_t(info.size());
+	}
+
+	close(fd);
+
+	if (!ok)
+		throw Error(path + ": Corrupt binary log");
+
+	return info;
+}
+
+
+//
+// Write a binary log, with info header @info and files @files
+//
+void BinLog::write(std::ostream& os, string const& info, vector<File*> const& files)
+{
+	vector<File*> sorted(files);
+	std::sort(sorted.begin(), sorted.end(), name_less);
+
+	// build the records and the string table.
+	// The empty string is at offset 0, shared by all non-symlinks.
+
+	vector<Record> records(sorted.size());
+	string strings(1, '\0');
+
+	for (size_t i = 0; i < sorted.size(); ++i) {
+
+		Record& r = records[i];
+		File const* f = sorted[i];
+
+		r.size = f->size();
+		r.name_off = strings.size();
+		r.name_len = f->name().size();
+		strings.append(f->name().c_str(), f->name().size() + 1);
+
+		r.ln_name_off = 0;
+		r.ln_name_len = f->ln_name().size();
+		if (f->is_symlink()) {
+			r.ln_name_off = strings.size();
+			strings.append(f->ln_name().c_str(), f->ln_name().size() + 1);
+		}
+	}
+
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = FORMAT_VERSION;
+	header.info_len = info.size();
+	header.nfiles = records.size();
+	header.strings_len = strings.size();
+
+	os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	os.write(info.data(), info.size());
+	os.write("\0\0\0\0\0\0\0", align8(info.size()) - info.size());
+	if (!records.empty())
+		os.write(reinterpret_cast<char const*>(&records[0]), records.size() * sizeof(Record));
+	os.write(strings.data(), strings.size());
+}
+
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+static size_t align8(size_t n)
+{
+	return (n + 7) & ~size_t(7);
+}
+
+
+//
+// Compare the path [@name, @name + @len) with @path, like strcmp()
+//
+static int compare_name(char const* name, size_t len, string const& path)
+{
+	int ret = memcmp(name, path.data(), std::min(len, path.size()));
+
+	if (ret)
+		return ret;
+
+	return len < path.size() ? -1 : len > path.size();
+}
+
+
+static bool name_less(File* left, File* right)
+{
+	return left->name() < right->name();
+}
+
@@ -0,0 +1,89 @@
+//=======================================================================
+// binlog.h
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#ifndef LIBPORG_BINLOG_H
+#define LIBPORG_BINLOG_H
+
+#include "config.h"
+#include "mapfile.h"
+#include <iosfwd>
+#include <vector>
+
+
+namespace Porg {
+
+class File;
+
+//
+// Binary log of a package, read in place from a memory mapped file.
+//
+// Layout (in host byte order, since logs are not meant to be moved between
+// machines; use 'porg --convert=text' for that):
+//
+//		Header		magic, version and size of the sections below
+//		Info		info header, as in text logs ('#<char>:<value>' lines)
+//		Records		one per file, sorted by path
+//		Strings		paths and symlink contents, NUL terminated
+//
+// Info is padded to a multiple of 8 bytes, so that records are aligned.
+//
+class BinLog
+{
+	public:
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t info_len;
+		uint64_t nfiles;
+		uint64_t strings_len;
+	};
+
+	struct Record
+	{
+		uint64_t size;
+		uint32_t name_off;
+		uint32_t name_len;
+		uint32_t ln_name_off;
+		uint32_t ln_name_len;
+	};
+
+	BinLog(std::string const& path);
+
+	std::string info() const	{ return std::string(m_info, m_header->info_len); }
+	size_t nfiles() const		{ return m_header->nfiles; }
+
+	Record const& record(size_t i) const			{ return m_records[i]; }
+	char const* name(Record const& r) const			{ return m_strings + r.name_off; }
+	char const* ln_name(Record const& r) const		{ return m_strings + r.ln_name_off; }
+
+	File* file(size_t i) const;
+	bool find(std::string const& path) const;
+
+	static bool is_binlog(std::string const& path);
+	static std::string read_info(std::string const& path);
+	static void write(std::ostream&, std::string const& info, std::vector<File*> const&);
+
+	static char const MAGIC[8];
+	static uint32_t const FORMAT_VERSION = 1;
+
+	private:
+
+	MapFile m_map;
+	Header const* m_header;
+	char const* m_info;
+	Record const* m_records;
+	char const* m_strings;
+
+};	// class BinLog
+
+}	// namespace Porg
+
+
+#endif  // LIBPORG_BINLOG_H
@@ -0,0 +1,327 @@
+//=======================================================================
+// catalog.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#include "config.h"
+#include "catalog.h"
+#include "basepkg.h"
+#include "baseopt.h"
+#include "mapfile.h"
+#include "index.h"		// LogdirLock, IndexBatch
+
+using std::string;
+using std::vector;
+using namespace Porg;
+
+static char const HEADER[] = "#!porg-catalog\n";
+static size_t const HEADER_LEN = sizeof(HEADER) - 1;
+
+static string catalog_file();
+static int64_t mtime_ns(struct stat const&);
+static bool parse_entry(char const*, char const*, Catalog::Entry&);
+static bool get_field(char const*&, char const*, char const*&);
+template <typename T> static bool get_num(char const*&, char const*, T&);
+
+
+//
+// Read the catalog file, if any
+//
+Catalog::Catalog()
+:
+	m_entries(),
+	m_changed(false)
+{
+	try
+	{
+		MapFile map(catalog_file());
+
+		if (map.size() < HEADER_LEN || memcmp(map.begin(), HEADER, HEADER_LEN))
+			return;
+
+		Entry e;
+
+		for (char const* p = map.begin() + HEADER_LEN, *eol; p < map.end(); p = eol + 1) {
+
+			if (!(eol = static_cast<char const*>(memchr(p, '\n', map.end() - p))))
+				eol = map.end();
+
+			if (parse_entry(p, eol, e))
+				m_entries[e.name] = e;
+		}
+	}
+	catch (Error const&) { }
+}
+
+
+//
+// Return the entry of package @name, if it's up to date with its log @log
+// (as returned by stat()), or NULL otherwise
+//
+Catalog::Entry const* Catalog::find(string const& name, struct stat const& log) const
+{
+	std::map<string, Entry>::const_iterator e = m_entries.find(name);
+
+	return e != m_entries.end() && e->second.mtime == mtime_ns(log) ? &e->second : 0;
+}
+
+
+//
+// Add or replace the entry of package @pkg, whose header has been read from
+// the log @log (as returned by stat())
+//
+void Catalog::set(BasePkg const& pkg, struct stat const& log)
+{
+	Entry e;
+
+	if (make_entry(pkg, log, e)) {
+		m_entries[pkg.name()] = e;
+		m_changed = true;
+	}
+}
+
+
+//
+// Fill @e with the fields of package @pkg, whose header has been read from
+// the log @log (as returned by stat()). Return false if they can't be
+// written to the catalog.
+//
+bool Catalog::make_entry(BasePkg const& pkg, struct stat const& log, Entry& e)
+{
+	// the catalog is line oriented, with '|' separated fields
+	if (pkg.name().find_first_of("|\n") != string::npos
+	|| pkg.summary().find('\n') != string::npos)
+		return false;
+
+	e.name = pkg.name();
+	e.mtime = mtime_ns(log);
+	e.binary = pkg.is_binary_log();
+	e.date = pkg.date();
+	e.size = pkg.size();
+	e.nfiles = pkg.nfiles();
+	e.summary = pkg.summary();
+
+	return true;
+}
+
+
+//
+// Save the catalog, with the entries of the packages @names (all those
+// logged), if it has changed and the log directory is writable
+//
+void Catalog::save(vector<string> const& names)
+{
+	std::map<string, Entry> entries;
+
+	for (vector<string>::const_iterator n(names.begin()); n != names.end(); ++n) {
+		std::map<string, Entry>::const_iterator e = m_entries.find(*n);
+		if (e != m_entries.end())
+			entries.insert(*e);
+	}
+
+	// drop the entries of packages no longer logged
+	if (entries.size() != m_entries.size())
+		m_changed = true;
+
+	m_entries.swap(entries);
+
+	if (!m_changed || !BaseOpt::logdir_writable())
+		return;
+
+	try
+	{
+		LogdirLock lock;
+		write();
+		m_changed = false;
+	}
+	catch (std::exception const&) { }
+}
+
+
+//
+// Update the entry of package @pkg, after writing its log (see IndexBatch).
+// A package that can't be written to the catalog loses its entry.
+//
+void Catalog::update(BasePkg const& pkg)
+{
+	std::map<string, Entry> changes;
+	std::map<string, Entry>& dest = IndexBatch::s_current
+		? IndexBatch::s_current->m_catalog : changes;
+
+	Entry& e = dest[pkg.name()];
+	struct stat s;
+
+	if (stat(pkg.log().c_str(), &s) < 0 || !make_entry(pkg, s, e))
+		e.name.clear();
+
+	if (!IndexBatch::s_current)
+		rewrite(changes);
+}
+
+
+//
+// Remove the entry of package @pkg_name, after removing its log (see
+// IndexBatch)
+//
+void Catalog::remove(string const& pkg_name)
+{
+	std::map<string, Entry> changes;
+	std::map<string, Entry>& dest = IndexBatch::s_current
+		? IndexBatch::s_current->m_catalog : changes;
+
+	dest[pkg_name].name.clear();
+
+	if (!IndexBatch::s_current)
+		rewrite(changes);
+}
+
+
+//
+// Rewrite the catalog, replacing the entries of the packages in @changes
+// with their new ones (those with no name are removed). If anything goes
+// wrong, remove the catalog, so that it will be rebuilt from the logs the
+// next time it's needed.
+//
+void Catalog::rewrite(std::map<string, Entry> const& changes)
+{
+	try
+	{
+		LogdirLock lock;
+		Catalog catalog;
+
+		for (std::map<string, Entry>::const_iterator c(changes.begin()); c != changes.end(); ++c) {
+			if (c->second.name.empty())
+				catalog.m_changed |= catalog.m_entries.erase(c->first) > 0;
+			else {
+				catalog.m_entries[c->first] = c->second;
+				catalog.m_changed = true;
+			}
+		}
+
+		if (catalog.m_changed)
+			catalog.write();
+	}
+	catch (...)
+	{
+		unlink(catalog_file().c_str());
+	}
+}
+
+
+//
+// Write the catalog file. Format:
+//
+//		#!porg-catalog
+//		<name>|<log mtime>|<b|t>|<date>|<size>|<nfiles>|<summary>	(one per package)
+//		...
+//
+void Catalog::write() const
+{
+	AtomicStream os(catalog_file());
+	char buf[NUM_BUFSIZE];
+
+	os << HEADER;
+
+	for (std::map<string, Entry>::const_iterator i(m_entries.begin()); i != m_entries.end(); ++i) {
+
+		Entry const& e = i->second;
+
+		os << e.name << '|';
+		os.write(buf, format_num(buf, e.mtime));
+		os << '|' << (e.binary ? 'b' : 't') << '|';
+		os.write(buf, format_num(buf, e.date));
+		os << '|';
+		os.write(buf, format_num(buf, ulong(e.size)));
+		os << '|';
+		os.write(buf, format_num(buf, e.nfiles));
+		os << '|' << e.summary << '\n';
+	}
+
+	os.commit();
+}
+
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+static string catalog_file()
+{
+	return BaseOpt::logdir() + "/.porg-catalog";
+}
+
+
+static int64_t mtime_ns(struct stat const& s)
+{
+#ifdef __APPLE__
+	return s.st_mtimespec.tv_sec * int64_t(1000000000) + s.st_mtimespec.tv_nsec;
+#else
+	return s.st_mtim.tv_sec * int64_t(1000000000) + s.st_mtim.tv_nsec;
+#endif
+}
+
+
+//
+// Parse the line [@p, @eol) of the catalog file into @e
+//
+static bool parse_entry(char const* p, char const* eol, Catalog::Entry& e)
+{
+	char const* field;
+	ulong size;
+
+	if (!get_field(p, eol, field) || p - 1 == field)
+		return false;
+
+	e.name.assign(field, p - 1);
+
+	if (!get_num(p, eol, e.mtime) || !get_field(p, eol, field) || p - field != 2
+	|| (*field != 'b' && *field != 't'))
+		return false;
+
+	e.binary = *field == 'b';
+
+	if (!get_num(p, eol, e.date) || !get_num(p, eol, size) || !get_num(p, eol, e.nfiles))
+		return false;
+
+	e.size = size;
+	e.summary.assign(p, eol);
+	return true;
+}
+
+
+//
+// Get in @field the start of the field at @p, and move @p past its '|'
+// separator
+//
+static bool get_field(char const*& p, char const* eol, char const*& field)
+{
+	char const* sep = static_cast<char const*>(memchr(p, '|', eol - p));
+
+	if (!sep)
+		return false;
+
+	field = p;
+	p = sep + 1;
+	return true;
+}
+
+
+//
+// Read a number followed by a '|' from @p, and move @p past them
+//
+template <typename T>
+static bool get_num(char const*& p, char const* eol, T& num)
+{
+	char const* end = parse_num(p, eol, num);
+
+	if (end == p || end == eol || *end != '|')
+		return false;
+
+	p = end + 1;
+	return true;
+}
+
@@ -0,0 +1,69 @@
+//=======================================================================
+// catalog.h
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#ifndef LIBPORG_CATALOG_H
+#define LIBPORG_CATALOG_H
+
+#include "config.h"
+#include <string>
+#include <vector>
+#include <map>
+
+
+namespace Porg {
+
+class BasePkg;
+
+//
+// Catalog of the database, with the fields of the log headers needed to
+// list the packages (date, size, number of files and summary), and the mtime
+// of each log. It is kept in the file '.porg-catalog' within the log
+// directory, one line per package, so that all the packages can be listed
+// with a single read instead of opening every log.
+// An entry is only used while its mtime matches that of the log, so a
+// missing or stale entry just means that the log has to be read.
+//
+class Catalog
+{
+	public:
+
+	struct Entry
+	{
+		std::string name;
+		int64_t mtime;		// of the log, in nanoseconds
+		bool binary;		// format of the log
+		int date;
+		float size;
+		ulong nfiles;
+		std::string summary;
+	};
+
+	Catalog();
+
+	Entry const* find(std::string const& name, struct stat const& log) const;
+	void set(BasePkg const& pkg, struct stat const& log);
+	void save(std::vector<std::string> const& names);
+
+	static void update(BasePkg const& pkg);
+	static void remove(std::string const& pkg_name);
+	static void rewrite(std::map<std::string, Entry> const& changes);
+
+	protected:
+
+	static bool make_entry(BasePkg const& pkg, struct stat const& log, Entry&);
+	void write() const;
+
+	std::map<std::string, Entry> m_entries;
+	bool m_changed;
+
+};	// class Catalog
+
+}	// namespace Porg
+
+
+#endif  // LIBPORG_CATALOG_H
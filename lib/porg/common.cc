@@ -8,36 +8,71 @@
 
 #include "config.h"
 #include "common.h"
+#include "pathlist.h"
 #include <sstream>
-#include <iomanip>
-#include <fnmatch.h>
+#include <cmath>
 
 using std::string;
 
-static string strip_repeated(string const&, char);
+static size_t format_sig2(char*, double);
 
 
 //
-// Create a human readable size
+// Write a human readable size into @buf (at least SIZE_BUFSIZE chars long),
+// with no terminating null. Return the number of chars written.
 //
-string Porg::fmt_size(float size)
+size_t Porg::format_size(char* buf, float size)
 {
-	std::ostringstream s;
+	size_t len;
+	char unit;
 	
 	if (size < KILOBYTE)
-		s << (ulong)size;
+		return format_num(buf, (ulong)size);
 	else if (size < (10 * KILOBYTE))
-		s << std::setprecision(2) << size / KILOBYTE << "k";
+		len = format_sig2(buf, size / KILOBYTE), unit = 'k';
 	else if (size < MEGABYTE)
-		s << (ulong)size / KILOBYTE << "k";
+		len = format_num(buf, (ulong)size / KILOBYTE), unit = 'k';
 	else if (size < (10 * MEGABYTE))
-		s << std::setprecision(2) << size / MEGABYTE << "M";
+		len = format_sig2(buf, size / MEGABYTE), unit = 'M';
 	else if (size < GIGABYTE)
-		s << (ulong)size / MEGABYTE << "M";
+		len = format_num(buf, (ulong)size / MEGABYTE), unit = 'M';
 	else
-		s << std::setprecision(2) << size / GIGABYTE << "G";
-		
-	return s.str();
+		len = format_sig2(buf, size / GIGABYTE), unit = 'G';
+
+	buf[len] = unit;
+	return len + 1;
+}
+
+
+//
+// Write a date into @buf (at least DATE_BUFSIZE chars long), with no
+// terminating null. Return the number of chars written.
+//
+size_t Porg::format_date(char* buf, time_t date, bool print_hour)
+{
+	char const* fmt = print_hour ? "%x %H:%M" : "%x";
+	struct tm t;
+	size_t len;
+
+	if (date && localtime_r(&date, &t) && (len = strftime(buf, DATE_BUFSIZE, fmt, &t)))
+		return len;
+
+	// if date == 0, or an error occurs, write whitespaces with the proper
+	// length
+	time_t now = time(0);
+	len = date != now ? format_date(buf, now, print_hour) : 0;
+	memset(buf, ' ', len);
+	return len;
+}
+
+
+//
+// Create a human readable size
+//
+string Porg::fmt_size(float size)
+{
+	char buf[SIZE_BUFSIZE];
+	return string(buf, format_size(buf, size));
 }
 
 
@@ -46,17 +81,8 @@ string Porg::fmt_size(float size)
 //
 string Porg::fmt_date(time_t date, bool print_hour)
 {
-	struct tm* t;
-	char str[32] = "";
-	string fmt(string("%x") + (print_hour ? " %H:%M" : ""));
-
-	if (date && (t = localtime(&date))
-		&& strftime(str, sizeof(str) - 1, fmt.c_str(), t))
-		return str;
-	else
-		// if date == 0, or an error occurs, return a string
-		// of whitespaces with the proper length
-		return string(fmt_date(time(0), print_hour).size(), ' ');
+	char buf[DATE_BUFSIZE];
+	return string(buf, format_date(buf, date, print_hour));
 }
 
 
@@ -68,44 +94,7 @@ string Porg::fmt_date(time_t date, bool print_hour)
 //
 bool Porg::in_paths(string const& inpath, string const& list)
 {
-	std::istringstream s(list + ":");
-	string path = strip_trailing(inpath, '/');
-
-	for (string buf; getline(s, buf, ':'); ) {
-
-		if (buf.empty())
-			continue;
-
-		buf = strip_repeated(strip_trailing(buf, '/'), '/');
-		
-		if (buf == "/")
-			return true;
-
-		else if (buf.find_first_of("*?[") == string::npos) {
-			if (buf == path || !path.find(buf + "/"))
-				return true;
-		}
-		
-		else if (!fnmatch(buf.c_str(), path.c_str(), 0))
-			return true;
-	}
-
-	return false;
-}
-
-
-//
-// Strip consecutive repeated occurrences of character c in str.
-//
-string strip_repeated(string const& str, char c)
-{
-	string ret = str, cc(2, c);
-	string::size_type p;
-
-	while ((p = ret.find(cc)) != string::npos)
-		ret.erase(p, 1);
-	
-	return ret;
+	return PathList(list).match(inpath);
 }
 
 
@@ -138,6 +127,55 @@ string Porg::to_lower(string const& str)
 }
 
 
+Porg::AtomicStream::AtomicStream(string const& path)
+:
+	std::ofstream(),
+	m_path(path),
+	m_tmp(),
+	m_committed(false)
+{
+	// the temporary file is hidden, so that it is skipped when reading the
+	// log directory
+	string::size_type p = path.rfind('/') + 1;
+	string tmp(path.substr(0, p) + "." + path.substr(p) + ".XXXXXX");
+
+	int fd = mkstemp(&tmp[0]);
+	if (fd < 0)
+		throw Error(tmp, errno);
+
+	fchmod(fd, 0644);
+	::close(fd);
+	m_tmp = tmp;
+
+	std::ofstream::open(m_tmp.c_str());
+	if (!is_open()) {
+		int errno_ = errno;
+		unlink(m_tmp.c_str());
+		throw Error(m_tmp, errno_);
+	}
+
+	exceptions(std::ios::badbit | std::ios::failbit);
+}
+
+
+Porg::AtomicStream::~AtomicStream()
+{
+	if (!m_committed)
+		unlink(m_tmp.c_str());
+}
+
+
+void Porg::AtomicStream::commit()
+{
+	close();
+
+	if (rename(m_tmp.c_str(), m_path.c_str()) < 0)
+		throw Error("rename(" + m_tmp + ", " + m_path + ")", errno);
+
+	m_committed = true;
+}
+
+
 //
 // Generic exception with errno support
 //
@@ -146,3 +184,50 @@ Porg::Error::Error(string const& msg, int errno_ /* = 0 */)
 	std::runtime_error(msg + (errno_ ? (string(": ") + strerror(errno_)) : ""))
 { }
 
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+//
+// Write @x (>= 1) with two significant digits, like printf("%.2g"), but
+// regardless of the locale
+//
+static size_t format_sig2(char* buf, double x)
+{
+	int exp = 0;
+	double digits;
+
+	// two digits, rounded to even on ties, like printf() does
+	while ((digits = std::nearbyint(x * 10 / std::pow(10.0, exp))) >= 100)
+		exp++;
+
+	ulong d = digits;
+
+	if (exp >= 2) {
+		// scientific notation, as in "1.5e+02"
+		size_t len = 0;
+		buf[len++] = '0' + d / 10;
+		if (d % 10) {
+			buf[len++] = '.';
+			buf[len++] = '0' + d % 10;
+		}
+		buf[len++] = 'e';
+		buf[len++] = '+';
+		if (exp < 10)
+			buf[len++] = '0';
+		return len + Porg::format_num(buf + len, exp);
+	}
+
+	if (exp == 1)
+		return Porg::format_num(buf, d);
+
+	size_t len = Porg::format_num(buf, d / 10);
+	if (d % 10) {
+		buf[len++] = '.';
+		buf[len++] = '0' + d % 10;
+	}
+	return len;
+}
+
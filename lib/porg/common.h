@@ -13,6 +13,8 @@
 #include <stdexcept>
 #include <iosfwd>
 #include <sstream>
+#include <fstream>
+#include <type_traits>
 
 
 namespace Porg
@@ -47,28 +49,124 @@ namespace Porg
 	};
 
 
-	// Convert string to numeric
+	// An output file stream that writes into a temporary file, which
+	// replaces the file @path on commit(). Readers never see a partially
+	// written file, and those that have it open or mapped keep seeing the
+	// old version.
+	class AtomicStream : public std::ofstream
+	{
+		public:
+		AtomicStream(std::string const& path);
+		~AtomicStream();
+		void commit();
+
+		private:
+		std::string const m_path;
+		std::string m_tmp;
+		bool m_committed;
+	};
+
+
+	// Conversions between numbers and text in the manner of C++17's
+	// std::from_chars() and std::to_chars(): they work on buffers given by
+	// the caller, allocate nothing, and don't depend on the locale.
+
+	size_t const NUM_BUFSIZE	= 24;	// any 64 bit integer, with sign
+	size_t const SIZE_BUFSIZE	= 32;
+	size_t const DATE_BUFSIZE	= 32;
+
+	// Parse a decimal integer from [@begin, @end) into @num. Return a pointer
+	// past the last digit, or @begin (leaving @num untouched) if there is none.
 	template <typename T>	// T = {int,long,unsigned,...}
-	T str2num(std::string const& s)
+	char const* parse_num(char const* begin, char const* end, T& num)
 	{
-		static std::istringstream is(s);
-		is.clear();
-		is.str(s);
-		T t;
+		static_assert(std::is_integral<T>::value, "parse_num(): integral type required");
+
+		typename std::make_unsigned<T>::type n = 0;
+		bool neg = std::is_signed<T>::value && begin < end && *begin == '-';
+		char const* digits = begin + neg;
+		char const* p;
+
+		for (p = digits; p < end && *p >= '0' && *p <= '9'; ++p)
+			n = n * 10 + (*p - '0');
+
+		if (p == digits)
+			return begin;
+
+		num = neg ? T(0 - n) : T(n);
+		return p;
+	}
+
+	// Write @num in decimal into @buf (at least NUM_BUFSIZE chars long),
+	// with no terminating null. Return the number of chars written.
+	template <typename T>	// T = {int,long,unsigned,...}
+	size_t format_num(char* buf, T num)
+	{
+		static_assert(std::is_integral<T>::value, "format_num(): integral type required");
+
+		typedef typename std::make_unsigned<T>::type U;
+
+		bool neg = std::is_signed<T>::value && num < T(0);
+		U n = neg ? U(0) - U(num) : U(num);
+		char tmp[NUM_BUFSIZE];
+		char* p = tmp + NUM_BUFSIZE;
+
+		do
+			*--p = '0' + n % 10;
+		while (n /= 10);
+
+		if (neg)
+			*--p = '-';
+
+		size_t len = tmp + NUM_BUFSIZE - p;
+		memcpy(buf, p, len);
+		return len;
+	}
+
+	// Convert string to integral numeric
+	template <typename T>
+	T str2num(std::string const& s, std::true_type)
+	{
+		char const* p = s.data();
+		char const* end = p + s.size();
+		T t = T();
+
+		while (p < end && isspace(static_cast<unsigned char>(*p)))
+			++p;
+
+		parse_num(p, end, t);
+		return t;
+	}
+
+	// Convert string to floating point numeric
+	// (no static stream here: logs may be read by several threads at once)
+	template <typename T>
+	T str2num(std::string const& s, std::false_type)
+	{
+		std::istringstream is(s);
+		T t = T();
 		is >> t;
 		return t;
 	}
 
-	// Convert numeric to string
+	// Convert string to numeric
+	template <typename T>	// T = {int,long,unsigned,float...}
+	T str2num(std::string const& s)
+	{
+		return str2num<T>(s, std::is_integral<T>());
+	}
+
+	// Convert integral numeric to string
 	template <typename T>
 	std::string num2str(T t)
 	{
-		std::ostringstream os("");
-		os << t;
-		return os.str();
+		char buf[NUM_BUFSIZE];
+		return std::string(buf, format_num(buf, t));
 	}
 
 
+	extern size_t format_size(char* buf, float size);
+	extern size_t format_date(char* buf, time_t date, bool print_hour);
 	extern std::string fmt_size(float size);
 	extern std::string fmt_date(time_t date, bool print_hour);
 	extern std::string strip_trailing(std::string const&, char);
@@ -25,20 +25,22 @@ File::File(string const& name_)
 {
 	struct stat s;
 
-	if (lstat(m_name.c_str(), &s) < 0)
-		return;
+	if (!lstat(m_name.c_str(), &s))
+		set_stat(s);
+}
 
-	else if (S_ISLNK(s.st_mode)) {
-		char ln[4096];
-		int cnt = readlink(m_name.c_str(), ln, sizeof(ln) - 1);
-		if (cnt > 0) {
-			ln[cnt] = 0;
-			m_ln_name = ln;
-		}
-	}
 
-	m_inode = s.st_ino;
-	m_size = s.st_size;
+//
+// Ctor. for newly logged files, already lstat()'ed
+//
+File::File(string const& name_, struct stat const& s)
+:
+	m_name(name_),
+	m_size(0),
+	m_inode(0),
+	m_ln_name()
+{
+	set_stat(s);
 }
 
 
@@ -54,6 +56,22 @@ File::File(string const& name_, ulong size_, string const& ln_name_ /* = "" */)
 { }
 
 
+void File::set_stat(struct stat const& s)
+{
+	if (S_ISLNK(s.st_mode)) {
+		char ln[4096];
+		int cnt = readlink(m_name.c_str(), ln, sizeof(ln) - 1);
+		if (cnt > 0) {
+			ln[cnt] = 0;
+			m_ln_name = ln;
+		}
+	}
+
+	m_inode = s.st_ino;
+	m_size = s.st_size;
+}
+
+
 bool File::is_missing() const
 {
 	struct stat s;
@@ -20,6 +20,7 @@ class File
 	public:
 
 	File(std::string const& name_);
+	File(std::string const& name_, struct stat const&);
 	File(std::string const& name_, ulong size_, std::string const& ln_name_ = "");
 
 	ulong size() const					{ return m_size; }
@@ -31,6 +32,8 @@ class File
 
 	private:
 
+	void set_stat(struct stat const&);
+
 	std::string const m_name;
 	ulong m_size;
 
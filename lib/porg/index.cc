@@ -0,0 +1,660 @@
+//=======================================================================
+// index.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#include "config.h"
+#include "index.h"
+#include "mapfile.h"
+#include "basepkg.h"
+#include "baseopt.h"
+#include "file.h"
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+using std::string;
+using std::vector;
+using namespace Porg;
+
+static char const HEADER[] = "#!porg-index\n";
+static size_t const HEADER_LEN = sizeof(HEADER) - 1;
+
+static string index_file();
+static int64_t ctime_ns(struct stat const&);
+static char const* line_end(char const*, char const*);
+static char const* find_sep(char const*, char const*);
+static int compare_path(char const*, char const*, string const&);
+static bool is_owner(char const*, char const*, string const&);
+static string const& get_owner(char const*, char const*, string&);
+static bool rec_less(char const*, size_t, char const*, size_t);
+static bool rec_less_str(string const&, string const&);
+
+
+//
+// Write a new version of the index, which is moved into place on commit()
+//
+class IndexWriter
+{
+	public:
+
+	IndexWriter(std::map<string, int64_t> const& logs)
+	:
+		m_stream(index_file())
+	{
+		char buf[NUM_BUFSIZE];
+
+		m_stream << HEADER;
+
+		for (std::map<string, int64_t>::const_iterator l(logs.begin()); l != logs.end(); ++l) {
+			m_stream.put('=');
+			m_stream.write(buf, format_num(buf, l->second));
+			m_stream << ' ' << l->first << '\n';
+		}
+	}
+
+	void write(char const* rec, size_t len)
+	{
+		m_stream.write(rec, len);
+		m_stream.put('\n');
+	}
+
+	void commit()	{ m_stream.commit(); }
+
+	private:
+
+	AtomicStream m_stream;
+
+};	// class IndexWriter
+
+
+Index::Index()
+:
+	m_map(0),
+	m_buf(),
+	m_begin(0),
+	m_end(0),
+	m_logs()
+{
+	open(std::set<string>(), true);
+}
+
+
+Index::Index(std::set<string> const& skip, bool save)
+:
+	m_map(0),
+	m_buf(),
+	m_begin(0),
+	m_end(0),
+	m_logs()
+{
+	open(skip, save);
+}
+
+
+Index::~Index()
+{
+	delete m_map;
+}
+
+
+//
+// Map the index file into memory, or build it from the logs if it's missing
+// or out of date. The logs in @skip are not taken into account when checking
+// whether the index is up to date. If @save is set, the rebuilt index is
+// saved, if possible.
+//
+void Index::open(std::set<string> const& skip, bool save)
+{
+	if (map(skip))
+		return;
+
+	if (save && BaseOpt::logdir_writable()) {
+		try
+		{
+			LogdirLock lock;
+
+			// somebody may have rebuilt it while we were waiting for the lock
+			if (map(skip))
+				return;
+
+			build();
+
+			IndexWriter writer(m_logs);
+			for (char const* p = m_begin, *eol; p < m_end; p = eol + 1) {
+				eol = line_end(p, m_end);
+				writer.write(p, eol - p);
+			}
+			writer.commit();
+			return;
+		}
+		catch (std::exception const&) { }
+	}
+
+	if (!m_begin)
+		build();
+}
+
+
+//
+// Map the index file into memory, if it's up to date
+//
+bool Index::map(std::set<string> const& skip)
+{
+	delete m_map;
+	m_map = 0;
+	m_logs.clear();
+
+	try
+	{
+		m_map = new MapFile(index_file());
+
+		char const* p = m_map->begin() + HEADER_LEN;
+		char const* end = m_map->end();
+		bool ok = m_map->size() >= HEADER_LEN && !memcmp(m_map->begin(), HEADER, HEADER_LEN);
+
+		// list of logs: '=<ctime> <name>'
+		for (char const* eol; ok && p < end && *p == '='; p = eol + 1) {
+			int64_t ctime;
+			eol = line_end(p, end);
+			char const* q = parse_num(p + 1, eol, ctime);
+			if ((ok = q > p + 1 && q < eol && *q == ' ' && q + 1 < eol))
+				m_logs[string(q + 1, eol)] = ctime;
+		}
+
+		if (ok) {
+			m_begin = p;
+			m_end = end;
+			if (is_up_to_date(skip))
+				return true;
+		}
+	}
+	catch (Error const&) { }
+
+	delete m_map;
+	m_map = 0;
+	m_logs.clear();
+	m_begin = m_end = 0;
+	return false;
+}
+
+
+//
+// Check that the logs in the directory (but those in @skip) are the ones
+// listed in the index, with the same change times
+//
+bool Index::is_up_to_date(std::set<string> const& skip) const
+{
+	DIR* dir = opendir(BaseOpt::logdir().c_str());
+	if (!dir)
+		return false;
+
+	size_t cnt = 0;
+	bool ret = true;
+	struct stat s;
+
+	for (struct dirent* e; ret && (e = readdir(dir)); ) {
+
+		if (e->d_name[0] == '.' || skip.count(e->d_name))
+			continue;
+
+		std::map<string, int64_t>::const_iterator l = m_logs.find(e->d_name);
+
+		ret = l != m_logs.end() && !fstatat(dirfd(dir), e->d_name, &s, 0)
+			&& ctime_ns(s) == l->second;
+		cnt++;
+	}
+
+	closedir(dir);
+
+	// no log listed has been removed
+	for (std::set<string>::const_iterator k(skip.begin()); ret && k != skip.end(); ++k)
+		cnt += m_logs.count(*k);
+
+	return ret && cnt == m_logs.size();
+}
+
+
+//
+// Build the index in memory, by reading all the logs in the database.
+//
+void Index::build()
+{
+	DIR* dir = opendir(BaseOpt::logdir().c_str());
+	if (!dir)
+		throw Error("opendir(\"" + BaseOpt::logdir() + "\")", errno);
+
+	vector<string> recs;
+	struct stat s;
+
+	m_logs.clear();
+
+	for (struct dirent* e; (e = readdir(dir)); ) {
+
+		// stat before reading, so that later changes are noticed
+		if (e->d_name[0] == '.' || fstatat(dirfd(dir), e->d_name, &s, 0) < 0)
+			continue;
+
+		m_logs[e->d_name] = ctime_ns(s);
+
+		try
+		{
+			BasePkg pkg(e->d_name);
+			pkg.read_log();
+
+			for (BasePkg::const_iter f(pkg.files().begin()); f != pkg.files().end(); ++f)
+				recs.push_back((*f)->name() + "|" + pkg.name());
+		}
+		catch (...) { }
+	}
+
+	closedir(dir);
+
+	std::sort(recs.begin(), recs.end(), rec_less_str);
+
+	m_buf.clear();
+	for (vector<string>::const_iterator r(recs.begin()); r != recs.end(); ++r)
+		(m_buf += *r) += '\n';
+
+	m_begin = m_buf.data();
+	m_end = m_buf.data() + m_buf.size();
+}
+
+
+//
+// Return the first record whose path is not less than @path
+//
+char const* Index::lower_bound(string const& path) const
+{
+	char const* lo = m_begin;
+	char const* hi = m_end;
+
+	while (lo < hi) {
+
+		char const* mid = lo + (hi - lo) / 2;
+		while (mid > lo && mid[-1] != '\n')
+			--mid;
+
+		char const* eol = line_end(mid, m_end);
+
+		if (compare_path(mid, eol, path) < 0)
+			lo = eol + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+
+//
+// Append to @pkgs the names of the packages that own the file @path
+//
+void Index::find(string const& path, vector<string>& pkgs) const
+{
+	for (char const* p = lower_bound(path), *eol; p < m_end; p = eol + 1) {
+
+		eol = line_end(p, m_end);
+
+		if (compare_path(p, eol, path))
+			break;
+
+		char const* sep = find_sep(p, eol);
+		string pkg(sep + 1, eol);
+
+		// skip packages whose log has been removed behind our back
+		if (!access((BaseOpt::logdir() + "/" + pkg).c_str(), F_OK))
+			pkgs.push_back(pkg);
+	}
+}
+
+
+//
+// Fill @owners with the files owned by more than one package, mapped to
+// their number of owners. The index has been checked against the logs in
+// the directory when opened, and only the owners whose log is still there
+// are counted, so that no file still owned by another package is taken as
+// unshared.
+//
+void Index::get_shared(std::unordered_map<string, uint>& owners) const
+{
+	// records of the same path are contiguous
+
+	char const* path = 0;
+	size_t path_len = 0;
+	uint cnt = 0;
+	string owner;
+
+	for (char const* p = m_begin, *eol; p < m_end; p = eol + 1) {
+
+		eol = line_end(p, m_end);
+		char const* sep = find_sep(p, eol);
+		size_t len = sep ? sep - p : eol - p;
+
+		if (!m_logs.count(get_owner(p, eol, owner)))
+			continue;
+
+		if (cnt && len == path_len && !memcmp(p, path, len)) {
+			cnt++;
+			continue;
+		}
+
+		if (cnt > 1)
+			owners[string(path, path_len)] = cnt;
+
+		path = p;
+		path_len = len;
+		cnt = 1;
+	}
+
+	if (cnt > 1)
+		owners[string(path, path_len)] = cnt;
+}
+
+
+//
+// Replace the records of package @pkg with its current list of files
+//
+void Index::update(BasePkg const& pkg)
+{
+	std::map<string, vector<string>> changes;
+	std::map<string, vector<string>>& dest = IndexBatch::s_current
+		? IndexBatch::s_current->m_changes : changes;
+
+	vector<string>& recs = dest[pkg.name()];
+	recs.clear();
+	recs.reserve(pkg.files().size());
+
+	for (BasePkg::const_iter f(pkg.files().begin()); f != pkg.files().end(); ++f)
+		recs.push_back((*f)->name() + "|" + pkg.name());
+
+	if (!IndexBatch::s_current)
+		rewrite(changes);
+}
+
+
+//
+// Remove all the records of package @pkg_name
+//
+void Index::remove(string const& pkg_name)
+{
+	std::map<string, vector<string>> changes;
+	std::map<string, vector<string>>& dest = IndexBatch::s_current
+		? IndexBatch::s_current->m_changes : changes;
+
+	dest[pkg_name].clear();
+
+	if (!IndexBatch::s_current)
+		rewrite(changes);
+}
+
+
+//
+// Rewrite the index, replacing the records of the packages in @changes
+// with their new ones (none for the removed packages). If anything goes
+// wrong, remove the index, so that it will be rebuilt from the logs the
+// next time it's needed.
+//
+void Index::rewrite(std::map<string, vector<string>>& changes)
+{
+	try
+	{
+		LogdirLock lock;
+		std::set<string> skip;
+		vector<string> recs;
+
+		for (std::map<string, vector<string>>::iterator c(changes.begin()); c != changes.end(); ++c) {
+			skip.insert(c->first);
+			recs.insert(recs.end(), c->second.begin(), c->second.end());
+		}
+
+		Index old(skip, false);
+
+		// list the logs written, and drop those removed
+		for (std::set<string>::const_iterator k(skip.begin()); k != skip.end(); ++k) {
+			struct stat s;
+			if (stat((BaseOpt::logdir() + "/" + *k).c_str(), &s) == 0)
+				old.m_logs[*k] = ctime_ns(s);
+			else
+				old.m_logs.erase(*k);
+		}
+
+		IndexWriter writer(old.m_logs);
+
+		std::sort(recs.begin(), recs.end(), rec_less_str);
+		vector<string>::const_iterator r(recs.begin());
+		string owner;
+
+		for (char const* p = old.m_begin, *eol; p < old.m_end; p = eol + 1) {
+
+			eol = line_end(p, old.m_end);
+
+			if (skip.size() == 1 ? is_owner(p, eol, *skip.begin())
+			: skip.count(get_owner(p, eol, owner)))
+				continue;
+
+			for ( ; r != recs.end() && rec_less(r->data(), r->size(), p, eol - p); ++r)
+				writer.write(r->data(), r->size());
+
+			writer.write(p, eol - p);
+		}
+
+		for ( ; r != recs.end(); ++r)
+			writer.write(r->data(), r->size());
+
+		writer.commit();
+	}
+	catch (...)
+	{
+		unlink(index_file().c_str());
+	}
+}
+
+
+//------------//
+// IndexBatch //
+//------------//
+
+
+IndexBatch* IndexBatch::s_current = 0;
+
+
+IndexBatch::IndexBatch()
+:
+	m_changes(),
+	m_catalog()
+{
+	// nested batches are merged into the outermost one
+	if (!s_current)
+		s_current = this;
+}
+
+
+IndexBatch::~IndexBatch()
+{
+	if (s_current != this)
+		return;
+
+	s_current = 0;
+
+	if (!m_changes.empty())
+		Index::rewrite(m_changes);
+
+	if (!m_catalog.empty())
+		Catalog::rewrite(m_catalog);
+}
+
+
+//------------//
+// LogdirLock //
+//------------//
+
+
+LogdirLock::LogdirLock()
+:
+	m_fd(open(BaseOpt::logdir().c_str(), O_RDONLY))
+{
+	if (m_fd < 0)
+		throw Error(BaseOpt::logdir(), errno);
+
+	if (flock(m_fd, LOCK_EX) < 0) {
+		int errno_ = errno;
+		close(m_fd);
+		throw Error("flock(" + BaseOpt::logdir() + ")", errno_);
+	}
+}
+
+
+LogdirLock::~LogdirLock()
+{
+	close(m_fd);
+}
+
+
+//-------------//
+// SharedFiles //
+//-------------//
+
+
+SharedFiles::SharedFiles()
+:
+	m_owners()
+{
+	Index().get_shared(m_owners);
+}
+
+
+//
+// Whether @path is owned by more than one package
+//
+bool SharedFiles::is_shared(string const& path) const
+{
+	return m_owners.find(path) != m_owners.end();
+}
+
+
+//
+// Forget package @pkg as owner of its files (after removing it)
+//
+void SharedFiles::del_pkg(BasePkg const& pkg)
+{
+	for (BasePkg::const_iter f(pkg.files().begin()); f != pkg.files().end(); ++f) {
+
+		std::unordered_map<string, uint>::iterator o = m_owners.find((*f)->name());
+
+		if (o != m_owners.end() && --o->second < 2)
+			m_owners.erase(o);
+	}
+}
+
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+static string index_file()
+{
+	return BaseOpt::logdir() + "/.porg-index";
+}
+
+
+//
+// Change time of a log, which (unlike the modification time) can't be set
+// back by restoring a copy
+//
+static int64_t ctime_ns(struct stat const& s)
+{
+#ifdef __APPLE__
+	return s.st_ctimespec.tv_sec * int64_t(1000000000) + s.st_ctimespec.tv_nsec;
+#else
+	return s.st_ctim.tv_sec * int64_t(1000000000) + s.st_ctim.tv_nsec;
+#endif
+}
+
+
+static char const* line_end(char const* p, char const* end)
+{
+	char const* eol = static_cast<char const*>(memchr(p, '\n', end - p));
+	return eol ? eol : end;
+}
+
+
+//
+// Get the '|' that separates the path and the package of the record
+// [@rec, @eol), or NULL if there's none. It's the last one: package names
+// can't contain '|', but paths can.
+//
+static char const* find_sep(char const* rec, char const* eol)
+{
+	while (eol > rec) {
+		if (*--eol == '|')
+			return eol;
+	}
+
+	return 0;
+}
+
+
+//
+// Compare the path of the record [@rec, @eol) with @path, like strcmp()
+//
+static int compare_path(char const* rec, char const* eol, string const& path)
+{
+	char const* sep = find_sep(rec, eol);
+	size_t len = sep ? sep - rec : eol - rec;
+	int ret = memcmp(rec, path.data(), std::min(len, path.size()));
+
+	if (ret)
+		return ret;
+
+	return len < path.size() ? -1 : len > path.size();
+}
+
+
+static bool is_owner(char const* rec, char const* eol, string const& pkg)
+{
+	char const* sep = find_sep(rec, eol);
+	return sep && size_t(eol - sep - 1) == pkg.size() && !pkg.compare(0, pkg.size(), sep + 1, pkg.size());
+}
+
+
+//
+// Get into @owner the package of the record [@rec, @eol)
+//
+static string const& get_owner(char const* rec, char const* eol, string& owner)
+{
+	char const* sep = find_sep(rec, eol);
+	owner.assign(sep ? sep + 1 : eol, eol);
+	return owner;
+}
+
+
+//
+// Order records by path, and then by package name
+//
+static bool rec_less(char const* a, size_t alen, char const* b, size_t blen)
+{
+	char const* asep = find_sep(a, a + alen);
+	char const* bsep = find_sep(b, b + blen);
+	size_t apath = asep ? asep - a : alen;
+	size_t bpath = bsep ? bsep - b : blen;
+
+	int cmp = memcmp(a, b, std::min(apath, bpath));
+	if (cmp || apath != bpath)
+		return cmp ? cmp < 0 : apath < bpath;
+
+	cmp = memcmp(a + apath, b + bpath, std::min(alen - apath, blen - bpath));
+	return cmp ? cmp < 0 : alen - apath < blen - bpath;
+}
+
+
+static bool rec_less_str(string const& a, string const& b)
+{
+	return rec_less(a.data(), a.size(), b.data(), b.size());
+}
+
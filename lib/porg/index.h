@@ -0,0 +1,152 @@
+//=======================================================================
+// index.h
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#ifndef LIBPORG_INDEX_H
+#define LIBPORG_INDEX_H
+
+#include "config.h"
+#include "catalog.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+
+namespace Porg {
+
+class BasePkg;
+class MapFile;
+
+//
+// Reverse index of the database, mapping installed files to the packages
+// that own them. It is kept in the file '.porg-index' within the log
+// directory, as a list of lines of the form 'path|package', sorted by path,
+// preceded by the list of the logs indexed, with their change times.
+// It is updated along with the logs of the packages, and rebuilt from
+// scratch whenever it is missing, or the logs in the directory don't match
+// those listed (some log was added, removed or modified behind its back).
+//
+class Index
+{
+	public:
+
+	Index();
+	~Index();
+
+	void find(std::string const& path, std::vector<std::string>& pkgs) const;
+	void get_shared(std::unordered_map<std::string, uint>& owners) const;
+
+	static void update(BasePkg const& pkg);
+	static void remove(std::string const& pkg_name);
+
+	protected:
+
+	Index(std::set<std::string> const& skip, bool save);
+
+	void open(std::set<std::string> const& skip, bool save);
+	bool map(std::set<std::string> const& skip);
+	bool is_up_to_date(std::set<std::string> const& skip) const;
+	void build();
+	char const* lower_bound(std::string const& path) const;
+
+	static void rewrite(std::map<std::string, std::vector<std::string>>& changes);
+
+	MapFile* m_map;
+	std::string m_buf;
+	char const* m_begin;
+	char const* m_end;
+	std::map<std::string, int64_t> m_logs;	// log -> ctime (in ns)
+
+	private:
+
+	Index(Index const&);
+	Index& operator=(Index const&);
+
+	friend class IndexBatch;
+
+};	// class Index
+
+
+//
+// While an object of this class exists, the updates of the index made by
+// Index::update() and Index::remove(), and those of the catalog made by
+// Catalog::update() and Catalog::remove(), are held back, and applied all at
+// once when it's destroyed, so that each file is rewritten only once when
+// removing or converting several packages.
+//
+class IndexBatch
+{
+	public:
+
+	IndexBatch();
+	~IndexBatch();
+
+	private:
+
+	IndexBatch(IndexBatch const&);
+	IndexBatch& operator=(IndexBatch const&);
+
+	// new records of each package updated (none if removed)
+	std::map<std::string, std::vector<std::string>> m_changes;
+
+	// new catalog entry of each package updated (with no name if removed)
+	std::map<std::string, Catalog::Entry> m_catalog;
+
+	static IndexBatch* s_current;
+
+	friend class Index;
+	friend class Catalog;
+
+};	// class IndexBatch
+
+
+//
+// Exclusive lock on the log directory, to serialize updates of the files
+// kept in it along with the logs (the index and the catalog)
+//
+class LogdirLock
+{
+	public:
+
+	LogdirLock();
+	~LogdirLock();
+
+	private:
+
+	LogdirLock(LogdirLock const&);
+	LogdirLock& operator=(LogdirLock const&);
+
+	int m_fd;
+
+};	// class LogdirLock
+
+
+//
+// Files owned by more than one package, with their number of owners, as
+// found in the index. Used to skip shared files when removing packages.
+//
+class SharedFiles
+{
+	public:
+
+	SharedFiles();
+
+	bool is_shared(std::string const& path) const;
+	void del_pkg(BasePkg const& pkg);
+
+	private:
+
+	std::unordered_map<std::string, uint> m_owners;
+
+};	// class SharedFiles
+
+}	// namespace Porg
+
+
+#endif  // LIBPORG_INDEX_H
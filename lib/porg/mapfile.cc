@@ -0,0 +1,59 @@
+//=======================================================================
+// mapfile.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#include "config.h"
+#include "mapfile.h"
+#include "common.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+
+using std::string;
+using namespace Porg;
+
+
+MapFile::MapFile(string const& path)
+:
+	m_data(""),
+	m_size(0),
+	m_stat()
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw Error(path, errno);
+
+	if (fstat(fd, &m_stat) < 0) {
+		int errno_ = errno;
+		close(fd);
+		throw Error(path, errno_);
+	}
+
+	// mmap() fails with empty files
+	if (m_stat.st_size > 0) {
+
+		void* p = mmap(0, m_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (p == MAP_FAILED) {
+			int errno_ = errno;
+			close(fd);
+			throw Error("mmap(" + path + ")", errno_);
+		}
+
+		m_data = static_cast<char const*>(p);
+		m_size = m_stat.st_size;
+	}
+
+	close(fd);
+}
+
+
+MapFile::~MapFile()
+{
+	if (m_size)
+		munmap(const_cast<char*>(m_data), m_size);
+}
+
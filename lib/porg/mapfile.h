@@ -0,0 +1,47 @@
+//=======================================================================
+// mapfile.h
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#ifndef LIBPORG_MAPFILE_H
+#define LIBPORG_MAPFILE_H
+
+#include "config.h"
+#include <string>
+
+
+namespace Porg {
+
+//
+// A read-only memory mapped file.
+//
+class MapFile
+{
+	public:
+
+	MapFile(std::string const& path);
+	~MapFile();
+
+	char const* begin() const			{ return m_data; }
+	char const* end() const				{ return m_data + m_size; }
+	size_t size() const					{ return m_size; }
+	struct stat const& stat() const		{ return m_stat; }
+
+	private:
+
+	MapFile(MapFile const&);
+	MapFile& operator=(MapFile const&);
+
+	char const* m_data;
+	size_t m_size;
+	struct stat m_stat;
+
+};	// class MapFile
+
+}	// namespace Porg
+
+
+#endif  // LIBPORG_MAPFILE_H
@@ -0,0 +1,202 @@
+//=======================================================================
+// numbench.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+// Usage: porg-num-bench [COUNT]
+//
+// Benchmark of parse_num(), format_num() and format_size() against the
+// stream based str2num(), num2str() and fmt_size() they replaced. Both are
+// run on the same numbers, and must give the same results.
+//=======================================================================
+
+#include "config.h"
+#include "common.h"
+#include <chrono>
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using std::string;
+using std::vector;
+using namespace Porg;
+
+static long old_str2num(string const&);
+static string old_num2str(long);
+static string old_fmt_size(float);
+static double elapsed(std::chrono::steady_clock::time_point);
+static void report(char const* what, double old_time, double new_time);
+
+
+int main(int argc, char* argv[])
+{
+	size_t count = argc > 1 ? strtoul(argv[1], 0, 10) : 200000;
+	size_t errors = 0;
+
+	// numbers of all lengths, and both signs, plus the limits
+	vector<long> nums;
+	nums.push_back(0);
+	nums.push_back(-1);
+	nums.push_back(LONG_MAX);
+	nums.push_back(LONG_MIN);
+
+	// sizes from bytes to terabytes, as in the logs
+	vector<float> sizes;
+	sizes.push_back(0);
+	sizes.push_back(KILOBYTE - 1);
+	sizes.push_back(10 * KILOBYTE);
+	sizes.push_back(MEGABYTE);
+	sizes.push_back(GIGABYTE);
+
+	unsigned long x = 12345;
+
+	while (nums.size() < count) {
+		x = x * 6364136223846793005UL + 1442695040888963407UL;
+		long n = long(x >> (x % 63));
+		nums.push_back(x & 1 ? -n : n);
+		sizes.push_back(float(x >> (24 + x % 40)));
+	}
+
+	std::chrono::steady_clock::time_point t;
+	double old_time, new_time;
+
+	// formatting
+
+	vector<string> old_str(count), new_str(count);
+	char buf[NUM_BUFSIZE];
+
+	t = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; ++i)
+		old_str[i] = old_num2str(nums[i]);
+	old_time = elapsed(t);
+
+	t = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; ++i)
+		new_str[i].assign(buf, format_num(buf, nums[i]));
+	new_time = elapsed(t);
+
+	for (size_t i = 0; i < count; ++i) {
+		if (old_str[i] != new_str[i] && ++errors <= 20)
+			std::cerr << "porg-num-bench: format_num(" << old_str[i] << "): " << new_str[i] << '\n';
+	}
+
+	report("num2str()/format_num()", old_time, new_time);
+
+	// parsing
+
+	vector<long> old_num(count), new_num(count);
+
+	t = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; ++i)
+		old_num[i] = old_str2num(old_str[i]);
+	old_time = elapsed(t);
+
+	t = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; ++i) {
+		char const* p = old_str[i].data();
+		parse_num(p, p + old_str[i].size(), new_num[i]);
+	}
+	new_time = elapsed(t);
+
+	for (size_t i = 0; i < count; ++i) {
+		if (old_num[i] != new_num[i] && ++errors <= 20)
+			std::cerr << "porg-num-bench: parse_num(" << old_str[i] << "): " << new_num[i] << '\n';
+	}
+
+	report("str2num()/parse_num()", old_time, new_time);
+
+	// sizes
+
+	char size_buf[SIZE_BUFSIZE];
+
+	t = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; ++i)
+		old_str[i] = old_fmt_size(sizes[i]);
+	old_time = elapsed(t);
+
+	t = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; ++i)
+		new_str[i].assign(size_buf, format_size(size_buf, sizes[i]));
+	new_time = elapsed(t);
+
+	for (size_t i = 0; i < count; ++i) {
+		if (old_str[i] != new_str[i] && ++errors <= 20)
+			std::cerr << "porg-num-bench: format_size(" << std::setprecision(10)
+				<< sizes[i] << "): " << new_str[i] << ", was " << old_str[i] << '\n';
+	}
+
+	report("fmt_size()/format_size()", old_time, new_time);
+
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+//
+// str2num<long>() before parse_num()
+//
+static long old_str2num(string const& s)
+{
+	std::istringstream is(s);
+	long t = 0;
+	is >> t;
+	return t;
+}
+
+
+//
+// num2str<long>() before format_num()
+//
+static string old_num2str(long t)
+{
+	std::ostringstream os("");
+	os << t;
+	return os.str();
+}
+
+
+//
+// fmt_size() before format_size()
+//
+static string old_fmt_size(float size)
+{
+	std::ostringstream s;
+
+	if (size < KILOBYTE)
+		s << (ulong)size;
+	else if (size < (10 * KILOBYTE))
+		s << std::setprecision(2) << size / KILOBYTE << "k";
+	else if (size < MEGABYTE)
+		s << (ulong)size / KILOBYTE << "k";
+	else if (size < (10 * MEGABYTE))
+		s << std::setprecision(2) << size / MEGABYTE << "M";
+	else if (size < GIGABYTE)
+		s << (ulong)size / MEGABYTE << "M";
+	else
+		s << std::setprecision(2) << size / GIGABYTE << "G";
+
+	return s.str();
+}
+
+
+//
+// Seconds since @t
+//
+static double elapsed(std::chrono::steady_clock::time_point t)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+}
+
+
+static void report(char const* what, double old_time, double new_time)
+{
+	std::cout << "porg-num-bench: " << what << ": " << old_time << " s, "
+		<< new_time << " s (" << (new_time > 0 ? old_time / new_time : 0) << "x)\n";
+}
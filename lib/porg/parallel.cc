@@ -0,0 +1,113 @@
+//=======================================================================
+// parallel.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#include "config.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace Porg;
+
+
+Workers::Workers(size_t njobs, std::function<void(size_t)> const& job)
+:
+	m_job(job),
+	m_njobs(njobs),
+	m_next(0),
+	m_done(0),
+	m_threads(),
+	m_mutex(),
+	m_cond(),
+	m_error()
+{
+	unsigned n = nthreads(njobs);
+
+	try
+	{
+		for (unsigned i = 0; i < n; ++i)
+			m_threads.push_back(std::thread(&Workers::run, this));
+	}
+	catch (std::system_error const&)
+	{
+		// couldn't create more threads: go on with those we have, or run
+		// the jobs in this thread if there are none
+		if (m_threads.empty())
+			run();
+	}
+}
+
+
+Workers::~Workers()
+{
+	for (size_t i = 0; i < m_threads.size(); ++i) {
+		if (m_threads[i].joinable())
+			m_threads[i].join();
+	}
+}
+
+
+//
+// Number of threads to use for @njobs jobs
+//
+unsigned Workers::nthreads(size_t njobs)
+{
+	unsigned n = std::max(1u, std::thread::hardware_concurrency());
+	return std::min<size_t>(n, njobs);
+}
+
+
+//
+// Wait at most @msecs milliseconds for the jobs to finish.
+// Return whether they are all done.
+//
+bool Workers::wait(unsigned msecs)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	return m_cond.wait_for(lock, std::chrono::milliseconds(msecs),
+		[this] { return m_done == m_njobs; });
+}
+
+
+//
+// Wait for all the jobs to finish, and rethrow the first exception thrown
+// by any of them, if any
+//
+void Workers::join()
+{
+	for (size_t i = 0; i < m_threads.size(); ++i) {
+		if (m_threads[i].joinable())
+			m_threads[i].join();
+	}
+
+	if (m_error)
+		std::rethrow_exception(m_error);
+}
+
+
+void Workers::run()
+{
+	for (size_t i; (i = m_next++) < m_njobs; ) {
+
+		try
+		{
+			m_job(i);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_error)
+				m_error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (++m_done == m_njobs)
+			m_cond.notify_all();
+	}
+}
+
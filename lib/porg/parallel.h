@@ -0,0 +1,64 @@
+//=======================================================================
+// parallel.h
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#ifndef LIBPORG_PARALLEL_H
+#define LIBPORG_PARALLEL_H
+
+#include "config.h"
+#include <functional>
+#include <exception>
+#include <condition_variable>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace Porg {
+
+//
+// Pool of threads that run job(0), job(1), ..., job(njobs - 1) concurrently.
+// The jobs are started as soon as the object is created. Each job must only
+// touch data of its own (e.g. the i-th slot of a preallocated vector), so
+// that the results can be collected in order once all the jobs are done.
+//
+class Workers
+{
+	public:
+
+	Workers(size_t njobs, std::function<void(size_t)> const& job);
+	~Workers();
+
+	size_t done() const		{ return m_done; }
+	bool wait(unsigned msecs);
+	void join();
+
+	static unsigned nthreads(size_t njobs);
+
+	private:
+
+	Workers(Workers const&);
+	Workers& operator=(Workers const&);
+
+	void run();
+
+	std::function<void(size_t)> const m_job;
+	size_t const m_njobs;
+	std::atomic<size_t> m_next;
+	std::atomic<size_t> m_done;
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::exception_ptr m_error;
+
+};	// class Workers
+
+}	// namespace Porg
+
+
+#endif  // LIBPORG_PARALLEL_H
@@ -0,0 +1,164 @@
+//=======================================================================
+// pathbench.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+// Usage: porg-pathlist-bench [ROUNDS]
+//
+// Benchmark of PathList::match() against the former in_paths(), which
+// parsed the list again on every call. Both are run on the same lists and
+// paths, and must give the same results.
+//=======================================================================
+
+#include "config.h"
+#include "pathlist.h"
+#include "common.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <fnmatch.h>
+
+using std::string;
+using std::vector;
+using namespace Porg;
+
+static bool old_in_paths(string const&, string const&);
+static string strip_repeated(string const&, char);
+static double elapsed(std::chrono::steady_clock::time_point);
+
+
+int main(int argc, char* argv[])
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 10;
+
+	char const* lists[] = {
+		// like the default exclude list, plus some patterns
+		"/tmp:/dev:/proc:/sys:/run:/var/tmp:/home:/root:/usr/share/doc/*/html:/opt/*/cache",
+		// like an include list
+		"/usr:/etc:/opt/foo*:/var/lib",
+		// not normalized entries
+		"//usr//lib/:/a/b/:/x*/y:/data/[ab]?/z:foo:/srv/*",
+		"/",
+	};
+
+	char const* dirs[] = {
+		"/usr/bin", "/usr/lib/x86_64-linux-gnu", "/usr/share/doc/pkg/html",
+		"/usr/share/man/man1", "/tmp/build", "/home/user/.cache", "/opt/foo/cache",
+		"/opt/foobar/lib", "/etc", "/etc/default", "/var/tmp", "/var/lib/pkg",
+		"/data/a1/z", "/x1/y", "/srv/www", "foo", "/usr//lib", "/a/b",
+	};
+
+	char const* edges[] = {
+		"", "/", "//", "/usr", "/usr/", "/usr///", "/usrx", "/usr/lib", "/usr/lib/",
+		"/tmp", "/tmpfoo", "/a/b", "/a/bc", "/a/b/", "/x/y///", "/x1/y/", "foo",
+		"foo/bar", "/data/b2/z/", "/srv", "/srv/", "/opt/foo", "/opt/foo/",
+	};
+
+	vector<string> paths(edges, edges + sizeof(edges) / sizeof(*edges));
+
+	for (size_t d = 0; d < sizeof(dirs) / sizeof(*dirs); ++d) {
+		for (int i = 0; i < 200; ++i)
+			paths.push_back(string(dirs[d]) + "/file" + num2str(i) + (i % 50 ? "" : "/"));
+	}
+
+	size_t const nlists = sizeof(lists) / sizeof(*lists);
+	size_t errors = 0;
+	double old_time = 0, new_time = 0;
+
+	for (size_t l = 0; l < nlists; ++l) {
+
+		vector<bool> old_res(paths.size()), new_res(paths.size());
+
+		std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+
+		for (int r = 0; r < rounds; ++r) {
+			for (size_t p = 0; p < paths.size(); ++p)
+				old_res[p] = old_in_paths(paths[p], lists[l]);
+		}
+
+		old_time += elapsed(t);
+		t = std::chrono::steady_clock::now();
+
+		for (int r = 0; r < rounds; ++r) {
+			PathList list(lists[l]);
+			for (size_t p = 0; p < paths.size(); ++p)
+				new_res[p] = list.match(paths[p]);
+		}
+
+		new_time += elapsed(t);
+
+		for (size_t p = 0; p < paths.size(); ++p) {
+			if (old_res[p] != new_res[p] && ++errors <= 20)
+				std::cerr << "porg-pathlist-bench: '" << paths[p] << "' in '" << lists[l]
+					<< "': in_paths() " << old_res[p] << ", PathList " << new_res[p] << '\n';
+		}
+	}
+
+	if (errors)
+		return EXIT_FAILURE;
+
+	std::cout << "porg-pathlist-bench: " << paths.size() << " paths x " << nlists
+		<< " lists x " << rounds << " rounds: in_paths() " << old_time << " s, PathList "
+		<< new_time << " s (" << (new_time > 0 ? old_time / new_time : 0) << "x)\n";
+
+	return EXIT_SUCCESS;
+}
+
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+//
+// in_paths() before PathList
+//
+static bool old_in_paths(string const& inpath, string const& list)
+{
+	std::istringstream s(list + ":");
+	string path = strip_trailing(inpath, '/');
+
+	for (string buf; getline(s, buf, ':'); ) {
+
+		if (buf.empty())
+			continue;
+
+		buf = strip_repeated(strip_trailing(buf, '/'), '/');
+
+		if (buf == "/")
+			return true;
+
+		else if (buf.find_first_of("*?[") == string::npos) {
+			if (buf == path || !path.find(buf + "/"))
+				return true;
+		}
+
+		else if (!fnmatch(buf.c_str(), path.c_str(), 0))
+			return true;
+	}
+
+	return false;
+}
+
+
+static string strip_repeated(string const& str, char c)
+{
+	string ret = str, cc(2, c);
+	string::size_type p;
+
+	while ((p = ret.find(cc)) != string::npos)
+		ret.erase(p, 1);
+
+	return ret;
+}
+
+
+//
+// Seconds since @t
+//
+static double elapsed(std::chrono::steady_clock::time_point t)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+}
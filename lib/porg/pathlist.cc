@@ -0,0 +1,207 @@
+//=======================================================================
+// pathlist.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#include "config.h"
+#include "pathlist.h"
+#include "common.h"
+#include <algorithm>
+#include <sstream>
+#include <fnmatch.h>
+#include <limits.h>
+
+using std::string;
+using namespace Porg;
+
+static size_t const NONE = size_t(-1);
+
+static string strip_repeated(string const&, char);
+static int compare_name(string const&, char const*, size_t);
+
+
+PathList::PathList(string const& list)
+:
+	m_nodes(1),
+	m_globs(),
+	m_all(false)
+{
+	std::istringstream s(list + ":");
+
+	m_nodes[0].leaf = false;
+
+	for (string buf; getline(s, buf, ':'); ) {
+
+		if (buf.empty())
+			continue;
+
+		buf = strip_repeated(strip_trailing(buf, '/'), '/');
+
+		if (buf == "/")
+			m_all = true;
+
+		else if (buf.find_first_of("*?[") == string::npos)
+			add(buf);
+
+		else {
+			// the part of the pattern up to the last '/' before the
+			// first special character must match literally
+			Glob g;
+			string::size_type p = buf.find_first_of("*?[\\");
+			g.prefix = buf.substr(0, buf.rfind('/', p) + 1);
+			g.pattern = buf;
+			m_globs.push_back(g);
+		}
+	}
+}
+
+
+//
+// Add the literal path @path to the tree
+//
+void PathList::add(string const& path)
+{
+	size_t node = 0;
+
+	for (string::size_type pos = 0, end; pos <= path.size(); pos = end + 1) {
+
+		if ((end = path.find('/', pos)) == string::npos)
+			end = path.size();
+
+		size_t next = find_child(node, path.data() + pos, end - pos);
+
+		if (next == NONE) {
+
+			Node n;
+			n.leaf = false;
+			next = m_nodes.size();
+			m_nodes.push_back(n);
+
+			std::vector<std::pair<string, size_t> >& children = m_nodes[node].children;
+			std::pair<string, size_t> child(path.substr(pos, end - pos), next);
+			children.insert(std::lower_bound(children.begin(), children.end(), child), child);
+		}
+
+		node = next;
+	}
+
+	m_nodes[node].leaf = true;
+}
+
+
+//
+// Return the index of the child of @node named [@name, @name + @len),
+// or NONE if there's none
+//
+size_t PathList::find_child(size_t node, char const* name, size_t len) const
+{
+	std::vector<std::pair<string, size_t> > const& children = m_nodes[node].children;
+	size_t lo = 0, hi = children.size();
+
+	while (lo < hi) {
+
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = compare_name(children[mid].first, name, len);
+
+		if (!cmp)
+			return children[mid].second;
+		else if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NONE;
+}
+
+
+//
+// Whether @path is, or is inside, any of the literal paths in the list, or
+// matches any of its patterns
+//
+bool PathList::match(string const& path) const
+{
+	if (m_all)
+		return true;
+
+	// ignore trailing slashes (but a lone one)
+	size_t len = path.size();
+	while (len > 1 && path[len - 1] == '/')
+		len--;
+
+	size_t node = 0;
+
+	for (size_t pos = 0, end; pos <= len && node != NONE; pos = end + 1) {
+
+		end = path.find('/', pos);
+		if (end == string::npos || end > len)
+			end = len;
+
+		if ((node = find_child(node, path.data() + pos, end - pos)) != NONE && m_nodes[node].leaf)
+			return true;
+	}
+
+	if (m_globs.empty())
+		return false;
+
+	// fnmatch() wants the path without its trailing slashes null terminated:
+	// copy it to the stack, rather than allocating a new string
+	char buf[PATH_MAX];
+	char const* cpath = path.c_str();
+
+	if (len < path.size()) {
+		if (len >= sizeof(buf))
+			return false;	// too long to be the path of any file
+		memcpy(buf, cpath, len);
+		buf[len] = 0;
+		cpath = buf;
+	}
+
+	for (std::vector<Glob>::const_iterator g(m_globs.begin()); g != m_globs.end(); ++g) {
+
+		if (g->prefix.size() > len || path.compare(0, g->prefix.size(), g->prefix))
+			continue;
+
+		else if (!fnmatch(g->pattern.c_str(), cpath, 0))
+			return true;
+	}
+
+	return false;
+}
+
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+//
+// Strip consecutive repeated occurrences of character @c in @str.
+//
+static string strip_repeated(string const& str, char c)
+{
+	string ret = str, cc(2, c);
+	string::size_type p;
+
+	while ((p = ret.find(cc)) != string::npos)
+		ret.erase(p, 1);
+	
+	return ret;
+}
+
+
+//
+// Compare @a with the string [@b, @b + @len), like strcmp()
+//
+static int compare_name(string const& a, char const* b, size_t len)
+{
+	int ret = memcmp(a.data(), b, std::min(a.size(), len));
+
+	if (ret)
+		return ret;
+
+	return a.size() < len ? -1 : a.size() > len;
+}
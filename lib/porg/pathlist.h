@@ -0,0 +1,60 @@
+//=======================================================================
+// pathlist.h
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#ifndef LIBPORG_PATHLIST_H
+#define LIBPORG_PATHLIST_H
+
+#include "config.h"
+#include <vector>
+
+
+namespace Porg {
+
+//
+// Colon separated list of paths (such as those of the include, exclude and
+// skip options), compiled once to match many paths against it, the same
+// way as in_paths() does.
+//
+// Paths without wildcards are stored in a tree of path components, and
+// patterns are only tried on paths that begin with their literal prefix.
+//
+class PathList
+{
+	public:
+
+	PathList(std::string const& list);
+
+	bool match(std::string const& path) const;
+
+	private:
+
+	struct Node
+	{
+		std::vector<std::pair<std::string, size_t> > children;	// sorted by name
+		bool leaf;
+	};
+
+	struct Glob
+	{
+		std::string prefix;
+		std::string pattern;
+	};
+
+	void add(std::string const& path);
+	size_t find_child(size_t node, char const* name, size_t len) const;
+
+	std::vector<Node> m_nodes;	// m_nodes[0] is the root
+	std::vector<Glob> m_globs;
+	bool m_all;
+
+};	// class PathList
+
+}	// namespace Porg
+
+
+#endif  // LIBPORG_PATHLIST_H
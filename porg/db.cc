@@ -8,6 +8,8 @@
 
 #include "config.h"
 #include "porg/file.h"
+#include "porg/index.h"
+#include "porg/parallel.h"
 #include "db.h"
 #include "util.h"
 #include "main.h"
@@ -15,19 +17,21 @@
 #include "out.h"
 #include "pkg.h"
 #include <algorithm>
-#include <iomanip>
+#include <unordered_map>
 
 using std::cout;
 using std::endl;
 using std::vector;
-using std::setw;
 using std::string;
 using std::max;
 using namespace Porg;
 
+// names of the logged packages, by base name
+typedef std::unordered_map<string, vector<string> > PkgIndex;
+
 static int get_digits(ulong);
 static int get_width(ulong);
-static bool match_pkg(string const&, string const&);
+static void find_pkgs(PkgIndex const&, string const&, vector<string>&);
 
 
 DB::DB()
@@ -50,8 +54,18 @@ DB::~DB()
 void DB::get_pkgs_all()
 {
 	Dir dir(Opt::logdir());
+	vector<string> names;
+
+	for (string name; dir.read(name); names.push_back(name)) ;
 
-	for (string name; dir.read(name); add_pkg(name)) ;
+	// packages can be listed from the catalog
+	if (Opt::mode() == MODE_LIST_PKGS) {
+		Catalog catalog;
+		add_pkgs(names, &catalog);
+		catalog.save(names);
+	}
+	else
+		add_pkgs(names);
 
 	if (empty())
 		Out::vrb("porg: No packages logged in '" + Opt::logdir() + "'");
@@ -60,20 +74,39 @@ void DB::get_pkgs_all()
 
 //
 // Search the database for packages matching any of the strings in args given
-// by the command line
+// by the command line. The log directory is read only once, into an index
+// of the packages by base name.
 //
 void DB::get_pkgs(vector<string> const& args)
 {
 	Dir dir(Opt::logdir());
+	PkgIndex index;
 
-	for (uint i = 0; i < args.size(); ++i, dir.rewind()) {
-		
-		bool found = false;
+	for (string name; dir.read(name); )
+		index[Pkg::get_base(name)].push_back(name);
+
+	// same base name: sorted by version
+	for (PkgIndex::iterator i(index.begin()); i != index.end(); ++i)
+		std::sort(i->second.begin(), i->second.end());
 
-		for (string name; dir.read(name); )
-			found |= (match_pkg(args[i], name) && add_pkg(name));
+	vector<string> names;
+	vector<uint> arg_index;
 
-		if (!found) {
+	for (uint i = 0; i < args.size(); ++i) {
+		find_pkgs(index, args[i], names);
+		arg_index.resize(names.size(), i);
+	}
+
+	vector<bool> added(add_pkgs(names));
+	vector<bool> found(args.size(), false);
+
+	for (uint j = 0; j < names.size(); ++j) {
+		if (added[j])
+			found[arg_index[j]] = true;
+	}
+
+	for (uint i = 0; i < args.size(); ++i) {
+		if (!found[i]) {
 			Out::vrb("porg: " + args[i] + ": Package not logged");
 			g_exit_status = EXIT_FAILURE;
 		}
@@ -81,20 +114,63 @@ void DB::get_pkgs(vector<string> const& args)
 }
 
 
-bool DB::add_pkg(string const& name)
+//
+// Read the logs of the packages @names concurrently, and add the packages to
+// the database in the same order. Return whether each package was added.
+// If @catalog is given, the packages whose entry in it is up to date are
+// taken from there, and the entries of the others are updated.
+//
+vector<bool> DB::add_pkgs(vector<string> const& names, Catalog* catalog /* = 0 */)
 {
-	try 
-	{
-		Pkg* pkg = new Pkg(name);
-		push_back(pkg);
-		m_total_size += pkg->size();
-		m_total_files += pkg->nfiles();
-		return true;
+	vector<Pkg*> pkgs(names.size(), 0);
+	vector<struct stat> logs(catalog ? names.size() : 0);
+	vector<char> uncataloged(names.size(), false);	// not vector<bool>: written concurrently
+
+	// these modes need just the info header of the logs
+	bool header_only = Opt::mode() & (MODE_LIST_PKGS | MODE_INFO | MODE_CONF_OPTS);
+
+	Workers workers(names.size(), [&](size_t i) {
+		try
+		{
+			Catalog::Entry const* e;
+			bool log_stat = catalog && !stat((Opt::logdir() + "/" + names[i]).c_str(), &logs[i]);
+
+			if (log_stat && (e = catalog->find(names[i], logs[i])))
+				pkgs[i] = new Pkg(*e);
+			else {
+				pkgs[i] = new Pkg(names[i], header_only);
+				uncataloged[i] = log_stat;
+			}
+		}
+		catch (...)
+		{ }
+	});
+
+	workers.join();
+
+	if (catalog) {
+		for (uint i = 0; i < pkgs.size(); ++i) {
+			if (pkgs[i] && uncataloged[i])
+				catalog->set(*pkgs[i], logs[i]);
+		}
 	}
-	catch (...) 
-	{ 
-		return false; 
+
+	// merge the packages and sum up the totals in this thread, once all of
+	// them have been read
+
+	vector<bool> added(names.size(), false);
+	reserve(size() + names.size());
+
+	for (uint i = 0; i < pkgs.size(); ++i) {
+		if (pkgs[i]) {
+			push_back(pkgs[i]);
+			m_total_size += pkgs[i]->size();
+			m_total_files += pkgs[i]->nfiles();
+			added[i] = true;
+		}
 	}
+
+	return added;
 }
 
 
@@ -119,22 +195,6 @@ void DB::get_pkg_list_widths(int& size_w, int& nfiles_w) const
 }
 
 
-//
-// get width for printing file sizes
-//
-int DB::get_file_size_width() const
-{
-	int size_w = Opt::print_totals() ? get_width(m_total_size) : 0;
-
-	for (const_iterator p(begin()); p != end(); ++p) {
-		for (Pkg::const_iter f((*p)->files().begin()); f != (*p)->files().end(); ++f)
-			size_w = max(size_w, get_width((*f)->size()));
-	}
-
-	return size_w;
-}
-
-
 void DB::print_conf_opts() const
 {
 	for (const_iterator p(begin()); p != end(); ++p) {
@@ -150,25 +210,34 @@ void DB::print_conf_opts() const
 }
 
 
-void DB::query() const
+//
+// Print the packages that own each of the files given in the command line,
+// looking them up in the index of the database.
+//
+void DB::query()
 {
+	Index index;
+
 	for (uint i(0); i < Opt::args().size(); ++i) {
 		
-		bool found = false;
 		string path(clear_path(Opt::args()[i]));
-		cout << path << ':';
+		vector<string> pkgs;
+
+		index.find(path, pkgs);
+
+		Output::str(path);
+
+		if (!Output::tab())
+			Output::put(':');
 		
-		for (const_iterator p(begin()); p != end(); ++p) {
-			
-			if ((*p)->find_file(path)) {
-				found = true;
-				cout << "  " << (*p)->name();
-			}
+		for (vector<string>::const_iterator p(pkgs.begin()); p != pkgs.end(); ++p) {
+			Output::sep();
+			Output::str(*p);
 		}
 		
-		cout << endl;
+		Output::eol();
 
-		if (!found)
+		if (pkgs.empty())
 			g_exit_status = EXIT_FAILURE;
 	}
 }
@@ -208,28 +277,44 @@ void DB::remove() const
 			return;
 	}
 
+	// rewrite the index once, at the end
+	IndexBatch batch;
+
 	if (Opt::remove_unlog()) {
 		for (const_iterator p(begin()); p != end(); (*p++)->unlog()) ;
 		return;
 	}
 	
-	// auxiliary DB to check for shared files
-	DB aux;
-	aux.get_pkgs_all();
+	// files owned by other packages are not removed
+	SharedFiles shared;
 
 	for (const_iterator p(begin()); p != end(); ++p) {
-		(*p)->remove(aux);
-		aux.del_pkg((*p)->name());
+		(*p)->remove(shared);
+		shared.del_pkg(**p);
 	}
 }
 
 
-void DB::del_pkg(string const& name)
+//
+// Rewrite the logs of the packages in the format given by option -C
+//
+void DB::convert() const
 {
-	for (iterator p(begin()); p != end(); ++p) {
-		if ((*p)->name() == name) {
-			erase(p);
-			break;
+	string const format(Opt::convert_binary() ? "binary" : "text");
+	IndexBatch batch;
+
+	for (const_iterator p(begin()); p != end(); ++p) {
+		try
+		{
+			if ((*p)->convert(Opt::convert_binary()))
+				Out::vrb("Package '" + (*p)->name() + "' converted to " + format + " format");
+			else
+				Out::vrb("Package '" + (*p)->name() + "' already in " + format + " format");
+		}
+		catch (std::exception const& x)
+		{
+			std::cerr << "porg: " << x.what() << endl;
+			g_exit_status = EXIT_FAILURE;
 		}
 	}
 }
@@ -253,32 +338,50 @@ void DB::list_pkgs() const
 	
 	if (Opt::print_totals()) {
 		
-		if (Opt::print_sizes())
-			cout << setw(size_w) << fmt_size(m_total_size) << "  ";
+		if (Opt::print_sizes()) {
+			Output::size(m_total_size, size_w);
+			Output::sep();
+		}
 		
-		if (Opt::print_nfiles())
-			cout << setw(nfiles_w) << m_total_files << "  ";
+		if (Opt::print_nfiles()) {
+			Output::num(m_total_files, nfiles_w);
+			Output::sep();
+		}
 
-		if (Opt::print_date())
-			cout << fmt_date(0, Opt::print_hour()) << "  ";
+		if (Opt::print_date()) {
+			if (!Output::tab())
+				Output::date(0, Opt::print_hour());
+			Output::sep();
+		}
 		
-		cout << "TOTAL" << endl;
+		Output::str("TOTAL");
+		Output::eol();
 	}
 }
 
 
 void DB::list_files() const
 {
-	int size_w(get_file_size_width());
+	// file sizes are printed in a column of fixed width, so that the files
+	// can be listed without looking at all of them first
+	int size_w = Output::SIZE_COLUMN;
+
+	if (Opt::print_totals())
+		size_w = max(size_w, get_width(m_total_size));
 
 	for (const_iterator p(begin()); p != end(); ++p) {
 		(*p)->list_files(size_w);
-		if (!Opt::print_no_pkg_name() && size() > 1)
-			cout << endl;
+		// no empty records in machine readable output
+		if (!Opt::print_no_pkg_name() && size() > 1 && !Output::machine())
+			Output::eol();
 	}
 
-	if (Opt::print_totals())
-		cout << setw(size_w) << fmt_size(m_total_size) << "  TOTAL" << endl;
+	if (Opt::print_totals()) {
+		Output::size(m_total_size, size_w);
+		Output::sep();
+		Output::str("TOTAL");
+		Output::eol();
+	}
 }
 
 
@@ -344,30 +447,40 @@ static int get_digits(ulong n)
 
 inline static int get_width(ulong size)
 {
-	return fmt_size(size).size();
+	return Output::size_width(size);
 }
 
 
-static bool match_pkg(string const& str, string const& pkg)
+//
+// Append to @names the packages in @index matching @arg: those with the same
+// base name and whose version begins with that of @arg (followed by a
+// punctuation char), or all of them if @arg has no version.
+//
+static void find_pkgs(PkgIndex const& index, string const& arg, vector<string>& names)
 {
-	if (Opt::exact_version())
-		return str == pkg;
+	PkgIndex::const_iterator b = index.find(Pkg::get_base(arg));
+	if (b == index.end())
+		return;
 
-	string str_base = Pkg::get_base(str);
-	string pkg_base = Pkg::get_base(pkg);
-	string str_version = Pkg::get_version(str);
-	string pkg_version = Pkg::get_version(pkg);
-	
-	if (pkg_base != str_base)
-		return false;
+	vector<string> const& pkgs = b->second;
+
+	if (Opt::exact_version()) {
+		if (std::binary_search(pkgs.begin(), pkgs.end(), arg))
+			names.push_back(arg);
+		return;
+	}
 
-	else if (str_version.empty() || str_version == pkg_version)
-		return true;
+	if (Pkg::get_version(arg).empty()) {
+		names.insert(names.end(), pkgs.begin(), pkgs.end());
+		return;
+	}
 
-	else if (str_version.compare(0, str_version.size(), 
-		pkg_version.c_str(), str_version.size()))
-		return false;
+	// @arg is "<base>-<version>", so the matching packages are contiguous
 
-	return ispunct(pkg_version[str_version.size()]);
+	for (vector<string>::const_iterator p(std::lower_bound(pkgs.begin(), pkgs.end(), arg));
+	p != pkgs.end() && !p->compare(0, arg.size(), arg); ++p) {
+		if (p->size() == arg.size() || ispunct(static_cast<unsigned char>((*p)[arg.size()])))
+			names.push_back(*p);
+	}
 }
 
@@ -17,6 +17,7 @@
 namespace Porg {
 
 class Pkg;
+class Catalog;
 
 class DB : public std::vector<Pkg*>
 {
@@ -32,16 +33,16 @@ class DB : public std::vector<Pkg*>
 	void list_pkgs() const;
 	void list_files() const;
 	void print_conf_opts() const;
-	void query() const;
 	void remove() const;
+	void convert() const;
 	void print_info() const;
 
+	static void query();
+
 	protected:
 
 	void get_pkg_list_widths(int&, int&) const;
-	int get_file_size_width() const;
-	bool add_pkg(std::string const& name);
-	void del_pkg(std::string const& name);
+	std::vector<bool> add_pkgs(std::vector<std::string> const& names, Catalog* = 0);
 
 	class Sorter
 	{
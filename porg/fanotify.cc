@@ -0,0 +1,301 @@
+//=======================================================================
+// fanotify.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#include "config.h"
+#include "porg/common.h"
+#include "fanotify.h"
+#include <sstream>
+#include <fcntl.h>
+#ifdef __linux__
+#	include <sched.h>
+#	include <signal.h>
+#	include <mntent.h>
+#	include <sys/prctl.h>
+#	include <sys/mount.h>
+#	include <sys/statfs.h>
+#	include <sys/fanotify.h>
+#endif
+
+using std::string;
+using std::vector;
+using namespace Porg;
+
+
+#ifdef FAN_REPORT_DFID_NAME
+
+static uint64_t fsid_key(void const*);
+
+
+Fanotify::Fanotify(string const& include, string const& exclude)
+:
+	m_fd(-1),
+	m_mount_fds(),
+	m_dirs()
+{
+	// move to a private mount namespace, so that mounts made by the
+	// command don't leak out to the rest of the system
+
+	if (unshare(CLONE_NEWNS) < 0)
+		throw Error("unshare(CLONE_NEWNS)", errno);
+
+	if (mount("none", "/", 0, MS_REC | MS_PRIVATE, 0) < 0)
+		throw Error("mount()", errno);
+
+	if ((m_fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK
+	| FAN_UNLIMITED_QUEUE | FAN_REPORT_DFID_NAME, O_RDONLY | O_LARGEFILE)) < 0)
+		throw Error("fanotify_init()", errno);
+
+	// watch the filesystems of the included paths, and those mounted
+	// under them
+
+	std::istringstream is(include + ":");
+	bool marked = false;
+
+	for (string path; getline(is, path, ':'); ) {
+		if (!path.empty() && path.find_first_of("*?[") == string::npos)
+			marked |= mark(path);
+	}
+
+	if (!marked) {
+		int errno_ = errno;
+		close(m_fd);
+		throw Error("fanotify_mark()", errno_);
+	}
+
+	if (FILE* f = setmntent("/proc/self/mounts", "r")) {
+		while (struct mntent* m = getmntent(f)) {
+			if (in_paths(m->mnt_dir, include) && !in_paths(m->mnt_dir, exclude))
+				mark(m->mnt_dir);
+		}
+		endmntent(f);
+	}
+}
+
+
+Fanotify::~Fanotify()
+{
+	for (std::map<uint64_t, int>::iterator m(m_mount_fds.begin()); m != m_mount_fds.end(); ++m)
+		close(m->second);
+
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+
+//
+// Fork a process that runs as the init of a new pid namespace. The command
+// must be run, and the events read, by this child: fanotify reports the
+// events of processes outside the namespace of the reader with pid 0, so
+// they can be told apart even if they are already gone.
+// Return like fork().
+//
+pid_t Fanotify::fork_reader()
+{
+	int ns = open("/proc/self/ns/pid", O_RDONLY | O_CLOEXEC);
+	if (ns < 0)
+		throw Error("/proc/self/ns/pid", errno);
+
+	if (unshare(CLONE_NEWPID) < 0) {
+		int errno_ = errno;
+		close(ns);
+		throw Error("unshare(CLONE_NEWPID)", errno_);
+	}
+
+	pid_t pid = fork();
+	int errno_ = errno;
+
+	if (pid != 0) {
+		// the next children of this process go to its own namespace again
+		setns(ns, CLONE_NEWPID);
+		close(ns);
+		if (pid < 0)
+			throw Error("fork()", errno_);
+	}
+	else {
+		close(ns);
+		// don't outlive porg (see Logger::run_fanotify_reader())
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+	}
+
+	return pid;
+}
+
+
+//
+// Watch the filesystem of @path. Keep a descriptor on it, needed to
+// open the directories reported by the events.
+//
+bool Fanotify::mark(string const& path)
+{
+	struct statfs s;
+	int fd;
+
+	if (fanotify_mark(m_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+		FAN_CREATE | FAN_CLOSE_WRITE | FAN_MOVED_TO | FAN_ONDIR, AT_FDCWD, path.c_str()) < 0
+	|| statfs(path.c_str(), &s) < 0)
+		return false;
+
+	uint64_t key = fsid_key(&s.f_fsid);
+
+	if (!m_mount_fds.count(key) && (fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)) >= 0)
+		m_mount_fds[key] = fd;
+
+	return true;
+}
+
+
+//
+// Read the pending events, and append to @files the paths of the files
+// created, written or moved, and to @dirs those of the directories moved
+// (the files inside them must be looked for).
+//
+void Fanotify::read_events(vector<string>& files, vector<string>& dirs)
+{
+	union {
+		struct fanotify_event_metadata meta;
+		char buf[65536];
+	} u;
+
+	ssize_t len;
+
+	while ((len = read(m_fd, u.buf, sizeof(u.buf))) > 0) {
+
+		for (struct fanotify_event_metadata* e = &u.meta; FAN_EVENT_OK(e, len); e = FAN_EVENT_NEXT(e, len)) {
+
+			if (e->vers != FANOTIFY_METADATA_VERSION)
+				throw Error("fanotify: Unsupported event version");
+
+			struct fanotify_event_info_fid* info = reinterpret_cast<struct fanotify_event_info_fid*>(e + 1);
+			string path;
+
+			if (e->event_len < sizeof(*e) + sizeof(*info)
+			|| info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+				continue;
+
+			// a directory has been moved, by whatever process: the paths
+			// of the directories under it are no longer valid
+			if ((e->mask & FAN_ONDIR) && (e->mask & FAN_MOVED_TO))
+				m_dirs.clear();
+
+			if (is_foreign(e->pid) || !get_dir(fsid_key(&info->fsid), info->handle, path))
+				continue;
+
+			struct file_handle const* h = reinterpret_cast<struct file_handle const*>(info->handle);
+			char const* name = reinterpret_cast<char const*>(h->f_handle + h->handle_bytes);
+
+			path += "/";
+			path += name;
+
+			if (!(e->mask & FAN_ONDIR))
+				files.push_back(path);
+
+			else if (e->mask & FAN_MOVED_TO)
+				dirs.push_back(path);
+		}
+	}
+
+	if (len < 0 && errno != EAGAIN && errno != EINTR)
+		throw Error("read(fanotify)", errno);
+}
+
+
+//
+// Whether the event of process @pid is not the command's: that of a process
+// outside the pid namespace of the reader (reported as 0), or the reader's
+// own one
+//
+bool Fanotify::is_foreign(pid_t pid)
+{
+	return pid == 0 || pid == getpid();
+}
+
+
+//
+// Get the path of the directory with file handle @handle, in the filesystem
+// with id @fsid
+//
+bool Fanotify::get_dir(uint64_t fsid, void const* handle, string& path)
+{
+	std::map<uint64_t, int>::const_iterator m = m_mount_fds.find(fsid);
+	if (m == m_mount_fds.end())
+		return false;
+
+	struct file_handle const* h = static_cast<struct file_handle const*>(handle);
+	string key(reinterpret_cast<char const*>(&fsid), sizeof(fsid));
+	key.append(static_cast<char const*>(handle), sizeof(*h) + h->handle_bytes);
+
+	std::unordered_map<string, string>::const_iterator d = m_dirs.find(key);
+	if (d != m_dirs.end()) {
+		path = d->second;
+		return true;
+	}
+
+	// open_by_handle_at() wants a non const handle
+	vector<char> buf(key.begin() + sizeof(fsid), key.end());
+
+	int fd = open_by_handle_at(m->second, reinterpret_cast<struct file_handle*>(&buf[0]), O_PATH);
+	if (fd < 0)
+		return false;
+
+	char link[32], dir[4096];
+	snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+	ssize_t n = readlink(link, dir, sizeof(dir));
+	close(fd);
+
+	if (n <= 0 || n >= ssize_t(sizeof(dir)) || dir[0] != '/')
+		return false;
+
+	path.assign(dir, n);
+	if (path == "/")
+		path.clear();
+
+	m_dirs[key] = path;
+	return true;
+}
+
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+static uint64_t fsid_key(void const* fsid)
+{
+	uint64_t key;
+	memcpy(&key, fsid, sizeof(key));
+	return key;
+}
+
+
+#else	// !FAN_REPORT_DFID_NAME
+
+
+Fanotify::Fanotify(string const&, string const&)
+:
+	m_fd(-1),
+	m_mount_fds(),
+	m_dirs()
+{
+	throw Error("fanotify is not supported on this system");
+}
+
+
+Fanotify::~Fanotify() { }
+
+
+pid_t Fanotify::fork_reader()
+{
+	return -1;
+}
+
+
+void Fanotify::read_events(vector<string>&, vector<string>&) { }
+
+
+#endif	// FAN_REPORT_DFID_NAME
+
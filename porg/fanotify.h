@@ -0,0 +1,61 @@
+//=======================================================================
+// fanotify.h
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#ifndef PORG_FANOTIFY_H
+#define PORG_FANOTIFY_H
+
+#include "config.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Porg {
+
+//
+// Watch the filesystems under a list of paths with fanotify (Linux >= 5.9),
+// and collect the paths of the files created, written or moved into them.
+//
+// The watching process is moved into a private mount namespace, inherited
+// by the commands it runs afterwards. The events are read by a process
+// forked with fork_reader() into a new pid namespace, where the command is
+// run too. Events caused by processes outside that namespace are discarded,
+// so that the activity of the rest of the system doesn't get mixed up with
+// that of the logged command.
+//
+class Fanotify
+{
+	public:
+
+	Fanotify(std::string const& include, std::string const& exclude);
+	~Fanotify();
+
+	int fd() const	{ return m_fd; }
+
+	pid_t fork_reader();
+	void read_events(std::vector<std::string>& files, std::vector<std::string>& dirs);
+
+	private:
+
+	Fanotify(Fanotify const&);
+	Fanotify& operator=(Fanotify const&);
+
+	bool mark(std::string const& path);
+	bool is_foreign(pid_t);
+	bool get_dir(uint64_t fsid, void const* handle, std::string& path);
+
+	int m_fd;
+	std::map<uint64_t, int> m_mount_fds;	// one descriptor per filesystem
+	std::unordered_map<std::string, std::string> m_dirs;	// handle -> path
+
+};	// class Fanotify
+
+}	// namespace Porg
+
+
+#endif  // PORG_FANOTIFY_H
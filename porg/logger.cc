@@ -9,14 +9,21 @@
 #include "config.h"
 #include "out.h"
 #include "opt.h"
-#include "porg/common.h"	// in_paths()
+#include "porg/common.h"
 #include "util.h"
 #include "pkg.h"
 #include "newpkg.h"
 #include "logger.h"
+#include "fanotify.h"
+#include "snapshot.h"
+#include "porg/file.h"
+#include "porg/parallel.h"
 #include <fstream>
-#include <iterator>
 #include <glob.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 
 using namespace Porg;
@@ -24,15 +31,25 @@ using namespace std;
 
 static string search_libporg();
 static void set_env(char const* var, string const& val);
+static void find_files(string const& dir, vector<string>& files);
+static void write_all(int fd, string& buf);
+static void forward_signal(int sig);
 
 
 Logger::Logger()
 :
 	m_pkgname(Opt::log_pkg_name()),
-	m_files()
+	m_files(),
+	m_logged(),
+	m_include(Opt::include()),
+	m_exclude(Opt::exclude())
 {
 	if (Opt::args().empty())
 		read_files_from_stream(cin);
+	else if (Opt::log_fanotify())
+		read_files_from_fanotify();
+	else if (Opt::log_snapshot())
+		read_files_from_snapshot();
 	else
 		read_files_from_command();
 
@@ -45,6 +62,12 @@ Logger::Logger()
 }
 
 
+Logger::~Logger()
+{
+	for (vector<File*>::iterator f(m_logged.begin()); f != m_logged.end(); delete *f++) ;
+}
+
+
 void Logger::run()
 {
 	static Logger log;
@@ -59,14 +82,14 @@ void Logger::write_files_to_pkg() const
 		try 
 		{
 			Pkg already_logged_pkg(m_pkgname);
-			already_logged_pkg.append(m_files);
+			already_logged_pkg.append(m_logged);
 			done = true;
 		}
 		catch (...) { }
 	}
 
 	if (!done)
-		NewPkg newpkg(m_pkgname, m_files);
+		NewPkg newpkg(m_pkgname, m_logged);
 
 	if (Out::debug()) {
 		Out::dbg_title("logged files");
@@ -78,13 +101,30 @@ void Logger::write_files_to_pkg() const
 
 void Logger::write_files_to_stream(ostream& s) const
 {
-	copy(m_files.begin(), m_files.end(), ostream_iterator<string>(s, "\n"));
+	for (vector<File*>::const_iterator f(m_logged.begin()); f != m_logged.end(); ++f)
+		s << (*f)->name() << '\n';
 }
 
 
 void Logger::read_files_from_stream(istream& f)
 {
-	for (string buf; getline(f, buf); m_files.insert(buf)) ;
+	for (string buf; getline(f, buf); add_file(buf)) ;
+}
+
+
+//
+// Convert the input file to an absolute path, and add it to the list unless
+// it's excluded or not included (the list skips the paths already in it).
+//
+void Logger::add_file(string const& inpath)
+{
+	if (inpath.empty())
+		return;
+
+	string path(clear_path(inpath));
+
+	if (!m_exclude.match(path) && m_include.match(path))
+		m_files.add(path);
 }
 
 
@@ -100,11 +140,36 @@ void Logger::read_files_from_command()
 	if (close(mkstemp(tmpfile)) < 0)
 		snprintf(tmpfile, sizeof(tmpfile), "/tmp/porg%d", getpid());
 
+	// socket through which libporg-log sends the files as they are created.
+	// The tmp file is used only by processes that can't use the socket.
+	// If the socket can't be created, go on with the tmp file alone.
+
+	int sock[2] = { -1, -1 };
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sock) == 0)
+		fcntl(sock[0], F_SETFD, FD_CLOEXEC);
+
 	// exec command
 
 	try
 	{
-		exec_command(tmpfile);
+		pid_t pid = exec_command(tmpfile, sock[1]);
+		if (sock[1] >= 0)
+			close(sock[1]);
+		sock[1] = -1;
+
+		vector<char> buf(65536);
+
+		// each datagram holds one or more whole lines
+		wait_command(pid, sock[0], [&]() {
+			for (ssize_t n; (n = recv(sock[0], &buf[0], buf.size(), MSG_DONTWAIT)) > 0; ) {
+				for (char const* q = &buf[0], *end = q + n, *eol; q < end; q = eol + 1) {
+					if (!(eol = static_cast<char const*>(memchr(q, '\n', end - q))))
+						eol = end;
+					add_file(string(q, eol));
+				}
+			}
+		});
+
 		FileStream<ifstream> f(tmpfile);
 		read_files_from_stream(f);
 		unlink(tmpfile);
@@ -114,41 +179,64 @@ void Logger::read_files_from_command()
 		unlink(tmpfile);
 		throw;
 	}
+
+	if (sock[0] >= 0)
+		close(sock[0]);
 }
 
 
-void Logger::exec_command(string const& tmpfile) const
+//
+// Run the command in a child process, and return its pid.
+// If @tmpfile is empty, run it without libporg-log.
+//
+pid_t Logger::exec_command(string const& tmpfile, int sock) const
 {
 	pid_t pid = fork();
 
 	if (pid == 0) { // child
 
-		string command, libporg = search_libporg();
+		string command, libporg;
 		
 		for (uint i(0); i < Opt::args().size(); ++i)
 			command += Opt::args()[i] + " ";
 
+		Out::dbg_title("settings");
+
+		if (!tmpfile.empty()) {
+
+			libporg = search_libporg();
 #ifdef __APPLE__
-		set_env("DYLD_INSERT_LIBRARIES", libporg);
-		set_env("DYLD_FORCE_FLAT_NAMESPACE", "1");
+			set_env("DYLD_INSERT_LIBRARIES", libporg);
+			set_env("DYLD_FORCE_FLAT_NAMESPACE", "1");
 #else
-		set_env("LD_PRELOAD", libporg);
+			set_env("LD_PRELOAD", libporg);
 #endif
-		set_env("PORG_TMPFILE", tmpfile);
-		if (Out::debug())
-			set_env("PORG_DEBUG", "yes");
+			set_env("PORG_TMPFILE", tmpfile);
+			if (sock >= 0) {
+				struct stat s;
+				if (fstat(sock, &s) == 0)
+					set_env("PORG_LOGFD", num2str(sock) + ":" + num2str((unsigned long)s.st_ino));
+			}
+			if (Out::debug())
+				set_env("PORG_DEBUG", "yes");
 
-		Out::dbg_title("settings");
 #ifdef __APPLE__
-		Out::dbg("DYLD_INSERT_LIBRARIES = " + libporg);
-		Out::dbg("DYLD_FORCE_FLAT_NAMESPACE = 1");
+			Out::dbg("DYLD_INSERT_LIBRARIES = " + libporg);
+			Out::dbg("DYLD_FORCE_FLAT_NAMESPACE = 1");
 #else
-		Out::dbg("LD_PRELOAD = " + libporg); 
+			Out::dbg("LD_PRELOAD = " + libporg); 
 #endif
+		}
+		else if (Opt::log_fanotify())
+			Out::dbg("fanotify = yes");
+		else
+			Out::dbg("snapshot = yes");
+
 		Out::dbg("INCLUDE = " + Opt::include()); 
 		Out::dbg("EXCLUDE = " + Opt::exclude()); 
 		Out::dbg("command = " + command);
-		Out::dbg_title("libporg-log");
+		if (!tmpfile.empty())
+			Out::dbg_title("libporg-log");
 
 		char* cmd[] = { (char*)"sh", (char*)"-c", (char*)(command.c_str()), 0 };
 		execv("/bin/sh", cmd);
@@ -159,41 +247,255 @@ void Logger::exec_command(string const& tmpfile) const
 	else if (pid == -1)
 		throw Error("fork()", errno);
 
-	wait(0);
+	return pid;
 }
 
 
 //
-// Convert input files to absolute paths, skip excluded or not included
-// files, and skip non-regular or missing files.
+// Wait for the command (process @pid) to finish, meanwhile calling @read
+// whenever there's something to be read from descriptor @fd (if any).
+// @read must not block.
 //
-void Logger::filter_files()
+void Logger::wait_command(pid_t pid, int fd, std::function<void()> const& read)
 {
-	vector<string> filtered;
-	struct stat s;
-	
-	for (set<string>::iterator p = m_files.begin(); p != m_files.end(); ++p) {
+	if (fd < 0) {
+		while (waitpid(pid, 0, 0) < 0 && errno == EINTR) ;
+		return;
+	}
 
-		if ((*p).empty())
-			continue;
+	bool done = false;
 
-		string path(clear_path((*p)));
+	while (!done) {
 
-		// skip excluded or not included files
-		if (in_paths(path, Opt::exclude()) || !in_paths(path, Opt::include()))
-			continue;
-	
-		// skip missing files, if needed
-		else if (lstat(path.c_str(), &s) < 0 && !Opt::log_missing())
-			continue;
+		struct pollfd p;
+		p.fd = fd;
+		p.events = POLLIN;
+
+		if (poll(&p, 1, 100) < 0 && errno != EINTR)
+			throw Error("poll()", errno);
+
+		// once the command is done, read what it left behind, and leave
+		done = waitpid(pid, 0, WNOHANG) != 0;
+
+		read();
+	}
+}
 
-		// log only regular files or symlinks
-		else if (s.st_mode & (S_IFREG | S_IFLNK))
-			filtered.push_back(path);
+
+//
+// Run the command without libporg-log, and collect the files it creates
+// with fanotify.
+// The command is run, and the events are read, by a child process in a new
+// pid namespace (see Fanotify::fork_reader()), which sends the paths back
+// through a pipe, as 'f<file>\0' or 'd<directory>\0'.
+//
+void Logger::read_files_from_fanotify()
+{
+	Fanotify fan(Opt::include(), Opt::exclude());
+	vector<string> files, dirs;
+	int fd[2];
+
+	if (pipe(fd) < 0)
+		throw Error("pipe()", errno);
+
+	fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+
+	pid_t reader = fan.fork_reader();
+
+	if (reader == 0) {
+		close(fd[0]);
+		_exit(run_fanotify_reader(fan, fd[1]));
+	}
+
+	close(fd[1]);
+
+	vector<char> buf(65536);
+	string rec;
+	ssize_t n;
+
+	while ((n = read(fd[0], &buf[0], buf.size())) != 0) {
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			int errno_ = errno;
+			close(fd[0]);
+			throw Error("read(pipe)", errno_);
+		}
+
+		for (char const* q = &buf[0], *end = q + n, *eor; q < end; q = eor + 1) {
+
+			if (!(eor = static_cast<char const*>(memchr(q, 0, end - q)))) {
+				rec.append(q, end);
+				break;
+			}
+
+			rec.append(q, eor);
+
+			if (rec[0] == 'f')
+				add_file(rec.substr(1));
+			else if (rec[0] == 'd')
+				dirs.push_back(rec.substr(1));
+
+			rec.clear();
+		}
 	}
 
-	m_files.clear();
-	copy(filtered.begin(), filtered.end(), inserter(m_files, m_files.begin()));
+	close(fd[0]);
+
+	int status;
+	while (waitpid(reader, &status, 0) < 0 && errno == EINTR) ;
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+		throw Error("fanotify: Failed to read the events of the command");
+
+	// the files in directories moved into place don't produce any event
+
+	for (vector<string>::const_iterator d(dirs.begin()); d != dirs.end(); ++d)
+		find_files(*d, files);
+
+	for (vector<string>::const_iterator f(files.begin()); f != files.end(); ++f)
+		add_file(*f);
+}
+
+
+//
+// Body of the reader process of read_files_from_fanotify(): run the command,
+// and write to @fd the paths it creates, as they are reported by @fan.
+// Return the exit status of the process.
+//
+int Logger::run_fanotify_reader(Fanotify& fan, int fd)
+{
+	try
+	{
+		vector<string> files, dirs;
+		string out;
+
+		// As the init of its pid namespace, this process gets no signals
+		// but those it handles: pass the ones meant to stop porg (also sent
+		// when porg dies) on to the command and its descendants.
+
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = forward_signal;
+		sa.sa_flags = SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGINT, &sa, 0);
+		sigaction(SIGTERM, &sa, 0);
+		sigaction(SIGHUP, &sa, 0);
+
+		pid_t pid = exec_command("", -1);
+
+		wait_command(pid, fan.fd(), [&]() {
+
+			// reap the orphaned processes of the namespace, which are
+			// reparented to this one (reaping the command too makes
+			// wait_command() leave)
+			while (waitpid(-1, 0, WNOHANG) > 0) ;
+
+			fan.read_events(files, dirs);
+
+			for (vector<string>::const_iterator f(files.begin()); f != files.end(); ++f)
+				(out += 'f').append(*f) += '\0';
+			files.clear();
+
+			write_all(fd, out);
+		});
+
+		for (vector<string>::const_iterator d(dirs.begin()); d != dirs.end(); ++d)
+			(out += 'd').append(*d) += '\0';
+
+		write_all(fd, out);
+	}
+	catch (std::exception const& x)
+	{
+		std::cerr << "porg: " << x.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+//
+// Run the command without libporg-log, and collect the files created or
+// modified by comparing snapshots of the filesystem taken before and after.
+// The last snapshot is saved in the log directory, so that the next time
+// only the directories modified since then have to be read.
+//
+void Logger::read_files_from_snapshot()
+{
+	Snapshot before(Opt::include(), Opt::exclude());
+	Snapshot after(Opt::include(), Opt::exclude());
+	vector<string> files;
+
+	{
+		Snapshot cache(Opt::include(), Opt::exclude());
+		before.scan(cache.load(Snapshot::cache_file()) ? &cache : 0);
+	}
+
+	pid_t pid = exec_command("", -1);
+	wait_command(pid, -1, [](){});
+
+	// only the directories modified by the command have to be read again
+	after.scan(&before);
+	after.get_changes(before, files);
+
+	for (vector<string>::const_iterator f(files.begin()); f != files.end(); ++f)
+		add_file(*f);
+
+	if (Opt::logdir_writable()) {
+		try
+		{
+			after.save(Snapshot::cache_file());
+		}
+		catch (std::exception const& x)
+		{
+			Out::vrb(x.what());
+		}
+	}
+}
+
+
+//
+// Skip non-regular or missing files (excluded or not included files have
+// already been skipped by add_file()), and get the information of the rest.
+// Files are lstat()'ed in parallel, by chunks, and only once: the File
+// objects are built from the results.
+//
+void Logger::filter_files()
+{
+	size_t const CHUNK = 256;
+
+	m_files.sort();
+
+	vector<char const*> paths(m_files.begin(), m_files.end());
+	vector<File*> files(paths.size(), 0);
+
+	Workers((paths.size() + CHUNK - 1) / CHUNK, [&paths, &files, CHUNK](size_t c) {
+
+		size_t end = std::min(paths.size(), (c + 1) * CHUNK);
+		struct stat s;
+
+		for (size_t i = c * CHUNK; i < end; ++i) {
+
+			// skip missing files, if needed
+			if (lstat(paths[i], &s) < 0) {
+				if (Opt::log_missing())
+					files[i] = new File(paths[i], 0);
+			}
+
+			// log only regular files or symlinks
+			else if (s.st_mode & (S_IFREG | S_IFLNK))
+				files[i] = new File(paths[i], s);
+		}
+	}).join();
+
+	for (vector<File*>::const_iterator f(files.begin()); f != files.end(); ++f) {
+		if (*f)
+			m_logged.push_back(*f);
+	}
 }
 
 
@@ -228,9 +530,73 @@ static string search_libporg()
 }
 
 
+//
+// Append to @files the paths of the non directory files under @dir
+//
+static void find_files(string const& dir, vector<string>& files)
+{
+	vector<string> dirs(1, dir);
+	struct stat s;
+
+	while (!dirs.empty()) {
+
+		string path(dirs.back());
+		dirs.pop_back();
+
+		DIR* d = opendir(path.c_str());
+		if (!d)
+			continue;
+
+		for (struct dirent* e; (e = readdir(d)); ) {
+
+			if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+				continue;
+
+			string file(path + "/" + e->d_name);
+
+			if (lstat(file.c_str(), &s) < 0)
+				continue;
+			else if (S_ISDIR(s.st_mode))
+				dirs.push_back(file);
+			else
+				files.push_back(file);
+		}
+
+		closedir(d);
+	}
+}
+
+
 static void set_env(char const* var, string const& val)
 {
 	if (setenv(var, val.c_str(), 1) < 0)
 		throw Error(string("setenv('") + var + "', '" + val + "', 1)", errno);
 }
 
+
+//
+// Write @buf to @fd, and clear it
+//
+static void write_all(int fd, string& buf)
+{
+	for (char const* p = buf.data(), *end = p + buf.size(); p < end; ) {
+		ssize_t n = write(fd, p, end - p);
+		if (n < 0 && errno != EINTR)
+			throw Error("write()", errno);
+		p += n > 0 ? n : 0;
+	}
+
+	buf.clear();
+}
+
+
+//
+// Pass signal @sig on to all the processes in the pid namespace of the
+// fanotify reader, which is their init
+//
+static void forward_signal(int sig)
+{
+	int errno_ = errno;
+	kill(-1, sig);
+	errno = errno_;
+}
@@ -10,11 +10,17 @@
 #define PORG_LOG_H
 
 #include "config.h"
+#include "porg/pathlist.h"
+#include "pathpool.h"
 #include <iosfwd>
-#include <set>
+#include <functional>
+#include <vector>
 
 namespace Porg {
 
+class File;
+class Fanotify;
+
 class Logger
 {
 	public:
@@ -24,13 +30,22 @@ class Logger
 	protected:
 
 	std::string const		m_pkgname;
-	std::set<std::string> 	m_files;
+	PathPool				m_files;
+	std::vector<File*>		m_logged;
+	PathList const			m_include;
+	PathList const			m_exclude;
 	
 	Logger();
+	~Logger();
 
 	void read_files_from_command();
-	void exec_command(std::string const&) const;
+	void read_files_from_fanotify();
+	int run_fanotify_reader(Fanotify&, int fd);
+	void read_files_from_snapshot();
+	pid_t exec_command(std::string const&, int sock) const;
+	void wait_command(pid_t, int fd, std::function<void()> const& read);
 	void read_files_from_stream(std::istream&);
+	void add_file(std::string const&);
 	void write_files_to_pkg() const;
 	void write_files_to_stream(std::ostream&) const;
 	void filter_files();
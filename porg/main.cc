@@ -11,6 +11,7 @@
 #include "logger.h"
 #include "db.h"
 #include "main.h"
+#include "out.h"
 
 using namespace Porg;
 
@@ -31,35 +32,48 @@ int main(int argc, char* argv[])
 			return g_exit_status;
 		}
 
-		DB db;
+		if (Opt::mode() == MODE_QUERY)
+			DB::query();
 
-		if (Opt::mode() == MODE_QUERY || Opt::all_pkgs())
-			db.get_pkgs_all();
-		else
-			db.get_pkgs(Opt::args());
+		else {
 
-		if (db.empty())
-			return g_exit_status;
+			DB db;
+
+			if (Opt::all_pkgs())
+				db.get_pkgs_all();
+			else
+				db.get_pkgs(Opt::args());
+
+			if (db.empty())
+				return g_exit_status;
 
-		db.sort_pkgs(Opt::sort_type(), Opt::reverse_sort());
+			db.sort_pkgs(Opt::sort_type(), Opt::reverse_sort());
 
-		switch (Opt::mode()) {
-			case MODE_CONF_OPTS:	db.print_conf_opts();	break;
-			case MODE_INFO:			db.print_info();		break;
-			case MODE_LIST_PKGS:	db.list_pkgs();			break;
-			case MODE_LIST_FILES:	db.list_files();		break;
-			case MODE_REMOVE:		db.remove();			break;
-			case MODE_QUERY:		db.query();				break;
-			default: 				assert(0);				break;
+			switch (Opt::mode()) {
+				case MODE_CONF_OPTS:	db.print_conf_opts();	break;
+				case MODE_INFO:			db.print_info();		break;
+				case MODE_LIST_PKGS:	db.list_pkgs();			break;
+				case MODE_LIST_FILES:	db.list_files();		break;
+				case MODE_REMOVE:		db.remove();			break;
+				case MODE_CONVERT:		db.convert();			break;
+				default: 				assert(0);				break;
+			}
 		}
 	}
 
 	catch (std::exception const& x) 
 	{
+		// print what was listed before the error
+		Output::flush();
 		std::cerr << "porg: " << x.what() << '\n';
 		g_exit_status = EXIT_FAILURE;
 	}
 
+	if (!Output::flush()) {
+		std::cerr << "porg: write(): " << strerror(errno) << '\n';
+		g_exit_status = EXIT_FAILURE;
+	}
+
 	return g_exit_status;
 }
 
@@ -8,40 +8,118 @@
 
 #include "config.h"
 #include "porg/file.h"
-#include "porg/rexp.h"
+#include "porg/mapfile.h"
 #include "newpkg.h"
 #include "out.h"
 #include <string>
-#include <fstream>
-#include <glob.h>
+#include <algorithm>
+#include <functional>
+#include <dirent.h>
 
 using std::string;
-using std::set;
+using std::vector;
 using namespace Porg;
 
-static void get_var(string const&, string const&, string&);
-static void get_define(string const&, string const&, string&);
-static string search_file(string const&);
+//
+// Variable to be read from a metadata file, and where to store its value
+//
+struct Var
+{
+	char const* tag;
+	string* val;
+};
+
+typedef bool (*match_func)(char const*, char const*, char const*, string&);
+
+static void scan_file(string const&, std::function<bool(char const*, char const*)> const&);
+static void get_vars(string const&, Var const*, size_t);
+static bool match_var(char const*, char const*, char const*, string&);
+static bool is_var_sep(char);
+static bool match_define(char const*, char const*, char const*, string&);
+static bool match_configure(char const*, char const*, bool, string&);
+static char const* skip_space(char const*, char const*);
+static void search_cwd(string const*, string*, size_t);
+static char const* icon_suffix(string const&, size_t);
+static bool ends_with_path(string const&, size_t, string const&);
+static int stem_cmp(char const*, size_t, char const*, size_t);
+
+
+//
+// Values of a set of variables, searched for in the lines of a file.
+// When several variables go to the same place, the last one found wins.
+//
+class Vars
+{
+	public:
+
+	Vars(Var const* vars, size_t nvars)
+	:
+		m_vars(vars),
+		m_vals(nvars),
+		m_found(nvars, false),
+		m_left(nvars)
+	{ }
+
+	bool done() const	{ return !m_left; }
+
+	void match(char const* line, char const* eol, match_func match)
+	{
+		for (size_t i = 0; m_left && i < m_vals.size(); ++i) {
+			if (!m_found[i] && match(line, eol, m_vars[i].tag, m_vals[i])) {
+				m_found[i] = true;
+				m_left--;
+			}
+		}
+	}
+
+	void get() const
+	{
+		for (size_t i = 0; i < m_vals.size(); ++i) {
+			if (m_found[i])
+				*m_vars[i].val = m_vals[i];
+		}
+	}
 
+	private:
 
-NewPkg::NewPkg(string const& name_, set<string> const& files_)
+	Var const* m_vars;
+	vector<string> m_vals;
+	vector<bool> m_found;
+	size_t m_left;
+
+};	// class Vars
+
+
+NewPkg::NewPkg(string const& name_, vector<File*> const& files_)
 :
-	BasePkg(name_)
+	BasePkg(name_),
+	m_stems()
 {
-	for (set<string>::const_iterator f(files_.begin()); f != files_.end(); ++f)
-		log_file(*f);
+	m_stems.reserve(files_.size());
+
+	for (vector<File*>::const_iterator f(files_.begin()); f != files_.end(); ++f)
+		log_file(**f);
 	
 	if (m_files.empty())
 		throw Error(m_name + ": No files to log");;
 
+	std::sort(m_stems.begin(), m_stems.end(), [](Stem const& a, Stem const& b) {
+		int cmp = stem_cmp(a.begin, a.len, b.begin, b.len);
+		return cmp ? cmp < 0 : a.file < b.file;
+	});
+
 	Out::dbg_title("package information");
 
+	string names[] = { m_base_name + ".pc", m_base_name + ".desktop", m_base_name + ".spec" };
+	string paths[3];
+
+	search_files(names, paths, 3);
+
 	read_config();
-	read_pc();
-	read_desktop();
-	read_spec();
+	read_pc(paths[0]);
+	read_desktop(paths[1]);
+	read_spec(paths[2]);
 
-	get_configure_options();
 	get_icon_path();
 
 	Out::dbg_title();
@@ -59,100 +137,169 @@ NewPkg::NewPkg(string const& name_, set<string> const& files_)
 }
 
 
-void NewPkg::read_spec()
+void NewPkg::log_file(File const& file)
+{
+	BasePkg::log_file(file);
+
+	string const& name(m_files.back()->name());
+	size_t base = name.rfind('/') + 1;
+	size_t dot = name.rfind('.');
+
+	if (dot == string::npos || dot <= base)
+		dot = name.size();
+
+	Stem stem = { name.data() + base, dot - base, m_files.size() - 1 };
+	m_stems.push_back(stem);
+}
+
+
+//
+// Search for the metadata files @names of the package, and get their paths
+// into @paths. Installed .pc and .desktop files are found among the logged
+// files; the rest are searched for in the build directory.
+//
+void NewPkg::search_files(string const* names, string* paths, size_t n) const
+{
+	size_t left = n;
+
+	for (const_iter f(m_files.begin()); left && f != m_files.end(); ++f) {
+
+		string const& path((*f)->name());
+		char const* base = path.c_str() + path.rfind('/') + 1;
+
+		for (size_t i = 0; i < n; ++i) {
+			if (paths[i].empty() && names[i] == base && !access(path.c_str(), R_OK)) {
+				paths[i] = path;
+				left--;
+			}
+		}
+	}
+
+	if (left)
+		search_cwd(names, paths, n);
+}
+
+
+void NewPkg::read_spec(string const& spec)
 {
-	string spec(search_file(m_base_name + ".spec"));
 	if (spec.empty())
 		return;
 
 	Out::dbg("Reading " + spec);
 
-	get_var(spec, "Icon", m_icon_path);
-	get_var(spec, "Summary", m_summary);
-	get_var(spec, "URL", m_url);
-	get_var(spec, "Packager", m_author);
-	get_var(spec, "Vendor", m_author);
-	get_var(spec, "Copyright", m_license);
-	get_var(spec, "License", m_license);
+	Var const vars[] = {
+		{ "Icon", &m_icon_path },
+		{ "Summary", &m_summary },
+		{ "URL", &m_url },
+		{ "Packager", &m_author },
+		{ "Vendor", &m_author },
+		{ "Copyright", &m_license },
+		{ "License", &m_license }
+	};
+
+	Vars v(vars, sizeof(vars) / sizeof(*vars));
+	
+	// the description goes from the line '%description' up to the next
+	// line starting with '%' or '#'
+	enum { BEFORE, IN, AFTER } desc = BEFORE;
 
-	// get description
+	scan_file(spec, [&](char const* line, char const* eol) {
 
-	std::ifstream f(spec.c_str());
-	string buf;
+		v.match(line, eol, match_var);
 
-	while (getline(f, buf) && buf.find("%description") != 0) ;
-	
-	while (getline(f, buf) && buf.find_first_of("%#") != 0)
-		m_description += buf + '\n';
+		if (desc == BEFORE && eol - line >= 12 && !memcmp(line, "%description", 12))
+			desc = IN;
+		else if (desc == IN && eol > line && (*line == '%' || *line == '#'))
+			desc = AFTER;
+		else if (desc == IN)
+			m_description += string(line, eol) + '\n';
+
+		return !v.done() || desc != AFTER;
+	});
+
+	v.get();
 }
 
 
-void NewPkg::read_pc()
+void NewPkg::read_pc(string const& pc)
 {
-	string pc(search_file(m_base_name + ".pc"));
 	if (pc.empty())
 		return;
 
 	Out::dbg("Reading " + pc);
 
-	get_var(pc, "Description", m_summary);
-	get_var(pc, "URL", m_url);
+	Var const vars[] = {
+		{ "Description", &m_summary },
+		{ "URL", &m_url }
+	};
+
+	get_vars(pc, vars, sizeof(vars) / sizeof(*vars));
 }
 
 
-void NewPkg::read_desktop()
+void NewPkg::read_desktop(string const& desktop)
 {
-	string desktop(search_file(m_base_name + ".desktop"));
 	if (desktop.empty())
 		return;
 
 	Out::dbg("Reading " + desktop);
 
-	get_var(desktop, "Icon", m_icon_path);
-	get_var(desktop, "GenericName", m_summary);
-	get_var(desktop, "Comment", m_summary);
+	Var const vars[] = {
+		{ "Icon", &m_icon_path },
+		{ "GenericName", &m_summary },
+		{ "Comment", &m_summary }
+	};
+
+	get_vars(desktop, vars, sizeof(vars) / sizeof(*vars));
 }
 
 
+//
+// Get package information from the defines in config.log (or config.h),
+// and the configure options from config.log (or configure.log).
+// config.log, which may be quite big, is read only once.
+//
 void NewPkg::read_config()
 {
-	string config("config.log");
+	Var const defines[] = {
+		{ "PACKAGE_URL", &m_url },
+		{ "PACKAGE_BUGREPORT", &m_author },
+		{ "PACKAGE_NAME", &m_summary },
+		{ "PACKAGE_STRING", &m_summary }
+	};
 
-	if (access(config.c_str(), R_OK) < 0) {
-		config = "config.h";
-		if (access(config.c_str(), R_OK) < 0)
-			return;
-	}
+	Vars v(defines, sizeof(defines) / sizeof(*defines));
+	bool got_opts = false;
 
-	Out::dbg("Reading " + config);
+	if (!access("config.log", R_OK)) {
 
-	get_define(config, "PACKAGE_URL", m_url);
-	get_define(config, "PACKAGE_BUGREPORT", m_author);
-	get_define(config, "PACKAGE_NAME", m_summary);
-	get_define(config, "PACKAGE_STRING", m_summary);
-}
+		Out::dbg("Reading config.log");
 
+		scan_file("config.log", [&](char const* line, char const* eol) {
+			v.match(line, eol, match_define);
+			if (!got_opts)
+				got_opts = match_configure(line, eol, false, m_conf_opts);
+			return !v.done() || !got_opts;
+		});
 
-void NewPkg::get_configure_options()
-{
-	Rexp re("^ *\\$ .*/configure[[:space:]]+(.*)$");
-	string config("config.log");
-	std::ifstream f(config.c_str());
+		v.get();
+		return;
+	}
 
-	if (!f) {
-		f.open("configure.log");
-		if (!f)
-			return;
-		re.compile("./configure[[:space:]]+(.*)$");
+	if (!access("config.h", R_OK)) {
+		Out::dbg("Reading config.h");
+		scan_file("config.h", [&](char const* line, char const* eol) {
+			v.match(line, eol, match_define);
+			return !v.done();
+		});
+		v.get();
 	}
 
-	Out::dbg("Retrieving configure options from " + config);
-	
-	for (string buf; getline(f, buf); ) {
-		if (re.exec(buf)) {
-			m_conf_opts = re.match(1);
-			break;
-		}
+	if (!access("configure.log", R_OK)) {
+		Out::dbg("Retrieving configure options from configure.log");
+		scan_file("configure.log", [&](char const* line, char const* eol) {
+			return !match_configure(line, eol, true, m_conf_opts);
+		});
 	}
 }
 
@@ -169,79 +316,289 @@ void NewPkg::get_icon_path()
 		return;
 
 	// otherwise search for the icon file in the list of files installed by
-	// the package
-	
-	// if path does not have any image format suffix, add 'suf' to the expression
-	
-	string exp("/" + path);
-	string suf("\\.(png|xpm|jpg|ico|gif|svg)$");
-	Rexp re(suf, REG_ICASE);
-	
-	if (!re.exec(path))
-		exp += suf;
+	// the package, whose name is "*/<path>", or "*/<path>.<suffix>" if path
+	// does not have any image format suffix
 
-	// Search the logged files for the path of the icon
-	
-	re.compile(exp, REG_ICASE);
-	bool found = false;
+	size_t base = path.rfind('/') + 1;
+	char const* suf = icon_suffix(path, base);
+	char const* stem = path.data() + base;
+	size_t len = (suf ? suf - 1 : path.data() + path.size()) - stem;
+
+	std::vector<Stem>::const_iterator s = std::lower_bound(m_stems.begin(), m_stems.end(),
+		stem, [len](Stem const& a, char const* b) { return stem_cmp(a.begin, a.len, b, len) < 0; });
+
+	// candidates are sorted by their position in the list of files
+
+	for ( ; s != m_stems.end() && !stem_cmp(s->begin, s->len, stem, len); ++s) {
 
-	for (uint i(0); !found && i < m_files.size(); ++i) {
-		if (re.exec(m_files[i]->name())) {
-			path = m_files[i]->name();
-			found = !access(path.c_str(), F_OK);
+		string const& name(m_files[s->file]->name());
+		size_t end = s->begin - name.data() + s->len;
+
+		if ((suf ? ends_with_path(name, name.size(), path)
+			: ends_with_path(name, end, path) && icon_suffix(name, end))
+		&& !access(name.c_str(), F_OK)) {
+			path = name;
+			return;
 		}
 	}
 
-	if (!found)
-		path.clear();
+	path.clear();
 }
 
 
-void get_var(string const& file, string const& tag, string& val)
+//
+// Map @path into memory and call @line(begin, end) for each of its lines,
+// while it returns true
+//
+static void scan_file(string const& path, std::function<bool(char const*, char const*)> const& line)
 {
-	std::ifstream f(file.c_str());
-	Porg::Rexp re("^" + tag + "[[:space:]:=]+(.*)$", REG_ICASE);
+	try
+	{
+		MapFile map(path);
+
+		for (char const* p = map.begin(), *eol; p < map.end(); p = eol + 1) {
+			if (!(eol = static_cast<char const*>(memchr(p, '\n', map.end() - p))))
+				eol = map.end();
+			if (!line(p, eol))
+				break;
+		}
+	}
+	catch (Error const& x)
+	{
+		Out::dbg(x.what());
+	}
+}
+
+
+//
+// Read the variables @vars from @file, in a single pass
+//
+static void get_vars(string const& file, Var const* vars, size_t nvars)
+{
+	Vars v(vars, nvars);
+
+	scan_file(file, [&v](char const* line, char const* eol) {
+		v.match(line, eol, match_var);
+		return !v.done();
+	});
 
-	for (string buf; getline(f, buf); ) {
-		if (re.exec(buf)) {
-			val = re.match(1);
-			break;
+	v.get();
+}
+
+
+//
+// Match the line [@p, @eol) against 'TAG[[:space:]:=]+(.*)$', case
+// insensitively, and get the value into @val
+//
+static bool match_var(char const* p, char const* eol, char const* tag, string& val)
+{
+	size_t len = strlen(tag);
+
+	if (size_t(eol - p) <= len || strncasecmp(p, tag, len) || !is_var_sep(p[len]))
+		return false;
+
+	for (p += len; p < eol && is_var_sep(*p); ++p) ;
+
+	val.assign(p, eol);
+	return true;
+}
+
+
+static bool is_var_sep(char c)
+{
+	return isspace(static_cast<unsigned char>(c)) || c == ':' || c == '=';
+}
+
+
+//
+// Match the line [@p, @eol) against a C define of @tag, and get its value
+// (unquoted) into @val
+//
+static bool match_define(char const* p, char const* eol, char const* tag, string& val)
+{
+	size_t len = strlen(tag);
+
+	p = skip_space(p, eol);
+
+	if (eol - p < 8 || memcmp(p, "#define", 7) || !isspace(static_cast<unsigned char>(p[7])))
+		return false;
+
+	p = skip_space(p + 7, eol);
+
+	if (size_t(eol - p) <= len || memcmp(p, tag, len) 
+	|| !(isspace(static_cast<unsigned char>(p[len])) || p[len] == '"'))
+		return false;
+
+	for (p += len; p < eol && (isspace(static_cast<unsigned char>(*p)) || *p == '"'); ++p) ;
+
+	char const* end = eol;
+	while (end > p && end[-1] == '"')
+		--end;
+
+	if (end == p)
+		return false;
+
+	val.assign(p, end);
+	return true;
+}
+
+
+//
+// Match the line [@p, @eol) against a call to configure, as logged by it
+// in config.log (or in configure.log, if @log is set), and get the options
+// into @val
+//
+static bool match_configure(char const* p, char const* eol, bool log, string& val)
+{
+	char const* const CONFIGURE = "/configure";
+	size_t const LEN = 10;
+	char const* q;
+
+	if (log) {
+		// first '/configure' (not at the beginning of the line)
+		for (q = p + 1; q + LEN < eol; ++q) {
+			if (!memcmp(q, CONFIGURE, LEN) && isspace(static_cast<unsigned char>(q[LEN])))
+				break;
 		}
 	}
+
+	else {
+		// '$ ...', up to the last '/configure'
+		while (p < eol && *p == ' ')
+			++p;
+
+		if (size_t(eol - p) < LEN + 3 || p[0] != '$' || p[1] != ' ')
+			return false;
+
+		for (q = eol - LEN - 1; q >= p + 2; --q) {
+			if (!memcmp(q, CONFIGURE, LEN) && isspace(static_cast<unsigned char>(q[LEN])))
+				break;
+		}
+
+		if (q < p + 2)
+			return false;
+	}
+
+	if (q + LEN >= eol)
+		return false;
+
+	val.assign(skip_space(q + LEN, eol), eol);
+	return true;
+}
+
+
+static char const* skip_space(char const* p, char const* eol)
+{
+	while (p < eol && isspace(static_cast<unsigned char>(*p)))
+		++p;
+
+	return p;
 }
 
 
 //
-// Get a define from a C header file, unquoting the result.
+// Search the current directory, and its (non hidden) subdirectories up to
+// two levels down, for the files @names whose @paths are still empty, in a
+// single walk. For each name, get the first match at the least depth.
 //
-void get_define(string const& file, string const& tag, string& val)
+static void search_cwd(string const* names, string* paths, size_t n)
 {
-	std::ifstream f(file.c_str());
-	Porg::Rexp re("^[[:space:]]*#define[[:space:]]+" + tag 
-		+ "[[:space:]\"]+(.*[^\"])");
+	vector<string> dirs(1, "."), subdirs;
+	size_t left = 0;
+
+	for (size_t i = 0; i < n; ++i)
+		left += paths[i].empty();
+
+	for (int depth = 0; depth < 3 && left && !dirs.empty(); ++depth) {
+
+		// paths found at this depth
+		vector<string> found(n);
 
-	for (string buf; getline(f, buf); ) {
-		if (re.exec(buf)) {
-			val = re.match(1);
-			break;
+		for (vector<string>::const_iterator d(dirs.begin()); d != dirs.end(); ++d) {
+
+			DIR* dir = opendir(d->c_str());
+			if (!dir)
+				continue;
+
+			for (struct dirent* e; (e = readdir(dir)); ) {
+
+				if (e->d_name[0] == '.')
+					continue;
+
+				string path(depth ? *d + "/" + e->d_name : string(e->d_name));
+
+				for (size_t i = 0; i < n; ++i) {
+					if (paths[i].empty() && names[i] == e->d_name
+					&& (found[i].empty() || path < found[i]))
+						found[i] = path;
+				}
+
+				struct stat s;
+				if (depth < 2 && (e->d_type == DT_DIR || e->d_type == DT_LNK || e->d_type == DT_UNKNOWN)
+				&& !stat(path.c_str(), &s) && S_ISDIR(s.st_mode))
+					subdirs.push_back(path);
+			}
+
+			closedir(dir);
 		}
+
+		for (size_t i = 0; i < n; ++i) {
+			if (!found[i].empty()) {
+				paths[i] = found[i];
+				left--;
+			}
+		}
+
+		dirs.swap(subdirs);
+		subdirs.clear();
 	}
 }
 
 
-string search_file(string const& name)
+//
+// If the basename of @path (starting at @base) has an image format suffix,
+// return a pointer to it (past the dot), or NULL otherwise
+//
+static char const* icon_suffix(string const& path, size_t base)
 {
-	glob_t g;
-	memset(&g, 0, sizeof(g));
-	
-	string file, patt[3] = { name, "*/" + name, "*/*/" + name };
+	static char const* const sufs[] = { "png", "xpm", "jpg", "ico", "gif", "svg" };
+
+	size_t dot = path.rfind('.');
+
+	if (dot == string::npos || dot < base || path.size() - dot != 4)
+		return 0;
+
+	for (size_t i = 0; i < sizeof(sufs) / sizeof(*sufs); ++i) {
+		if (!strncasecmp(path.data() + dot + 1, sufs[i], 3))
+			return path.data() + dot + 1;
+	}
+
+	return 0;
+}
+
 
-	for (int i = 0; i < 3 && file.empty(); ++i) {
-		if (!glob(patt[i].c_str(), 0, 0, &g) && g.gl_pathc)
-			file = g.gl_pathv[0];
+//
+// Whether the first @end chars of @name end with "/<path>" (case insensitively)
+//
+static bool ends_with_path(string const& name, size_t end, string const& path)
+{
+	return end > path.size() && name[end - path.size() - 1] == '/'
+		&& !strncasecmp(name.data() + end - path.size(), path.data(), path.size());
+}
+
+
+//
+// Compare two stems case insensitively, like strcasecmp()
+//
+static int stem_cmp(char const* a, size_t alen, char const* b, size_t blen)
+{
+	for (size_t i = 0; i < alen && i < blen; ++i) {
+		int ca = tolower(static_cast<unsigned char>(a[i]));
+		int cb = tolower(static_cast<unsigned char>(b[i]));
+		if (ca != cb)
+			return ca - cb;
 	}
 
-	globfree(&g);
-	return file;
+	return alen < blen ? -1 : alen > blen;
 }
 
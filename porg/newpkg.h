@@ -12,7 +12,7 @@
 #include "config.h"
 #include "porg/basepkg.h"
 #include <iosfwd>
-#include <set>
+#include <vector>
 
 
 namespace Porg
@@ -22,18 +22,32 @@ class NewPkg : public BasePkg
 {
 	public:
 
-	NewPkg(std::string const& name_, std::set<std::string> const& files);
+	NewPkg(std::string const& name_, std::vector<File*> const& files);
 	
 	protected:
 
+	//
+	// Stem of the basename of a logged file (up to its last dot), as a range
+	// of the file name, for suffix lookups without scanning the whole list
+	//
+	struct Stem
+	{
+		char const* begin;
+		size_t len;
+		size_t file;	// position in m_files
+	};
+
+	void log_file(File const&);
 	void print_info_dbg() const;
 	void get_icon_path();
-	void get_configure_options();
-	void read_spec();
-	void read_pc();
-	void read_desktop();
+	void search_files(std::string const* names, std::string* paths, size_t n) const;
+	void read_spec(std::string const&);
+	void read_pc(std::string const&);
+	void read_desktop(std::string const&);
 	void read_config();
 
+	std::vector<Stem> m_stems;	// sorted by stem (case insensitively)
+
 };	// class NewPkg
 
 }	// namespace Porg
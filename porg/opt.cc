@@ -36,9 +36,12 @@ bool Opt::s_remove_batch = false;
 bool Opt::s_remove_unlog = false;
 bool Opt::s_log_append = false;
 bool Opt::s_log_missing = false;
+bool Opt::s_log_fanotify = false;
+bool Opt::s_log_snapshot = false;
 bool Opt::s_reverse_sort = false;
 bool Opt::s_print_date = false;
 bool Opt::s_print_hour = false;
+bool Opt::s_convert_binary = false;
 bool Opt::s_logdir_created = false;
 sort_t Opt::s_sort_type = SORT_BY_NAME;
 string Opt::s_log_pkg_name = "";
@@ -71,6 +74,7 @@ Opt::Opt(int argc, char* argv[])
 	char const
 		OPT_ALL				= 'a',
 		OPT_BATCH			= 'b',
+		OPT_CONVERT			= 'C',
 		OPT_DIRNAME			= 'D',
 		OPT_DATE			= 'd',
 		OPT_EXCLUDE			= 'E',
@@ -82,6 +86,7 @@ Opt::Opt(int argc, char* argv[])
 		OPT_INFO			= 'i',
 		OPT_LOGDIR			= 'L',
 		OPT_LOG				= 'l',
+		OPT_FANOTIFY		= 'N',
 		OPT_CONF_OPTS		= 'o',
 		OPT_PACKAGE			= 'p',
 		OPT_LOG_MISSING		= 'j',
@@ -90,6 +95,7 @@ Opt::Opt(int argc, char* argv[])
 		OPT_REMOVE			= 'r',
 		OPT_SORT			= 'S',
 		OPT_SIZE			= 's',
+		OPT_TAB				= 'T',
 		OPT_TOTAL			= 't',
 		OPT_UNLOG			= 'U',
 		OPT_VERSION			= 'V',
@@ -97,6 +103,8 @@ Opt::Opt(int argc, char* argv[])
 		OPT_EXACT_VERSION	= 'x',
 		OPT_SYMLINKS		= 'y',
 		OPT_NO_PACKAGE_NAME	= 'z',
+		OPT_SNAPSHOT		= 'Z',
+		OPT_NULL			= '0',
 		OPT_APPEND			= '+';
 
 	struct option opt[] = {
@@ -117,9 +125,12 @@ Opt::Opt(int argc, char* argv[])
 		{ "total", 				0, 0, OPT_TOTAL },
 		{ "symlinks", 			0, 0, OPT_SYMLINKS },
 		{ "no-package-name", 	0, 0, OPT_NO_PACKAGE_NAME },
+		{ "null", 				0, 0, OPT_NULL },
+		{ "tab", 				0, 0, OPT_TAB },
 		{ "info", 				0, 0, OPT_INFO },
 		{ "query", 				0, 0, OPT_QUERY },
 		{ "configure-options", 	0, 0, OPT_CONF_OPTS },
+		{ "convert", 			1, 0, OPT_CONVERT },
 		// Remove options
 		{ "remove", 			0, 0, OPT_REMOVE },
 		{ "batch", 				0, 0, OPT_BATCH },
@@ -133,6 +144,8 @@ Opt::Opt(int argc, char* argv[])
 		{ "append", 			0, 0, OPT_APPEND },
 		{ "dirname", 			0, 0, OPT_DIRNAME },
 		{ "log-missing", 		0, 0, OPT_LOG_MISSING },
+		{ "fanotify", 			0, 0, OPT_FANOTIFY },
+		{ "snapshot", 			0, 0, OPT_SNAPSHOT },
 		{ 0 ,0, 0, 0 },
 	};
 	
@@ -174,6 +187,9 @@ Opt::Opt(int argc, char* argv[])
 			case OPT_FILES: 			set_mode(MODE_LIST_FILES, c); break;
 			case OPT_LOG: 				set_mode(MODE_LOG, c); break;
 			case OPT_REMOVE:			set_mode(MODE_REMOVE, c); break;
+			case OPT_CONVERT:			set_mode(MODE_CONVERT, c);
+										set_convert_format(optarg);
+										break;
 
 			// other options
 
@@ -187,6 +203,8 @@ Opt::Opt(int argc, char* argv[])
 			case OPT_REVERSE:			s_reverse_sort = true; break;
 			case OPT_TOTAL:				s_print_totals = true; break;
 			case OPT_NO_PACKAGE_NAME:	s_print_no_pkg_name = true; break;
+			case OPT_NULL:				Output::set_null(); break;
+			case OPT_TAB:				Output::set_tab(); break;
 			case OPT_SIZE:				s_print_sizes = true; break;
 			case OPT_DATE:				s_print_hour = s_print_date;
 										s_print_date = true;
@@ -202,6 +220,8 @@ Opt::Opt(int argc, char* argv[])
 			case OPT_EXCLUDE:			s_exclude = optarg; break;
 			case OPT_APPEND:			s_log_append = true; break;
 			case OPT_LOG_MISSING:		s_log_missing = true; break;
+			case OPT_FANOTIFY:			s_log_fanotify = true; break;
+			case OPT_SNAPSHOT:			s_log_snapshot = true; break;
 
 			// unrecognized option
 			
@@ -223,12 +243,12 @@ Opt::Opt(int argc, char* argv[])
 			
 			case OPT_EXACT_VERSION:
 				check_mode(MODE_LIST_PKGS | MODE_LIST_FILES | MODE_INFO 
-					| MODE_CONF_OPTS | MODE_REMOVE, c);
+					| MODE_CONF_OPTS | MODE_REMOVE | MODE_CONVERT, c);
 				break;
 
 			case OPT_ALL:
 				check_mode(MODE_LIST_PKGS | MODE_LIST_FILES | MODE_INFO 
-					| MODE_CONF_OPTS, c);
+					| MODE_CONF_OPTS | MODE_CONVERT, c);
 				break;
 
 			case OPT_SORT:
@@ -244,6 +264,11 @@ Opt::Opt(int argc, char* argv[])
 				check_mode(MODE_LIST_PKGS, c);
 				break;
 
+			case OPT_NULL:
+			case OPT_TAB:
+				check_mode(MODE_LIST_PKGS | MODE_LIST_FILES | MODE_QUERY, c);
+				break;
+
 			case OPT_SYMLINKS:
 				check_mode(MODE_LIST_FILES, c);
 				break;
@@ -260,6 +285,8 @@ Opt::Opt(int argc, char* argv[])
 			case OPT_EXCLUDE:
 			case OPT_APPEND:
 			case OPT_LOG_MISSING:
+			case OPT_FANOTIFY:
+			case OPT_SNAPSHOT:
 				check_mode(MODE_LOG, c);
 				break;
 		}
@@ -291,6 +318,8 @@ Opt::Opt(int argc, char* argv[])
 			case OPT_PACKAGE:
 			case OPT_DIRNAME:
 			case OPT_LOG_MISSING:
+			case OPT_FANOTIFY:
+			case OPT_SNAPSHOT:
 			case OPT_EXCLUDE:
 			case OPT_INCLUDE:
 				check_required(c, string(1, OPT_LOG));
@@ -323,6 +352,12 @@ Opt::Opt(int argc, char* argv[])
 			break;
 
 		case MODE_LOG:
+			if (s_log_fanotify && s_args.empty())
+				die_help("Option -N requires a command to run");
+			if (s_log_snapshot && s_args.empty())
+				die_help("Option -Z requires a command to run");
+			if (s_log_fanotify && s_log_snapshot)
+				die_help("-NZ: Incompatible options");
 			if (!s_log_pkg_name.empty()) {
 				s_logdir_created = !mkdir(s_logdir.c_str(), 0755);
 				if (!logdir_writable())
@@ -335,7 +370,8 @@ Opt::Opt(int argc, char* argv[])
 			if (s_args.empty() && !s_all_pkgs)
 				die_help("No input packages");
 
-			else if (s_mode == MODE_REMOVE && !logdir_writable())
+			else if ((s_mode == MODE_REMOVE || s_mode == MODE_CONVERT)
+			&& !logdir_writable())
 				throw Error(s_logdir, errno);
 
 			// convert package names to lower case
@@ -403,6 +439,17 @@ void Opt::set_sort_type(string const& s)
 }
 
 
+void Opt::set_convert_format(string const& s)
+{
+	if (!s.empty() && !s.compare(0, s.size(), "binary", s.size()))
+		s_convert_binary = true;
+	else if (!s.empty() && !s.compare(0, s.size(), "text", s.size()))
+		s_convert_binary = false;
+	else
+		die_help("'" + s + "': Invalid argument for option '-C|--convert'");
+}
+
+
 static void help()
 {
 cout <<
@@ -419,7 +466,10 @@ cout <<
 "General list options:\n"
 "  -R, --reverse            Reverse order while sorting.\n"
 "  -t, --total              Print totals.\n"
-"  -z, --no-package-name    Don't print the name of the package.\n\n"
+"  -z, --no-package-name    Don't print the name of the package.\n"
+"  -T, --tab                Separate fields with tabs, and print sizes in bytes\n"
+"                           (also with -q).\n"
+"  -0, --null               End lines with a NUL character (also with -q).\n\n"
 "Package list options:\n"
 "  -d, --date               Print the installation day (-dd prints the hour too).\n"
 "  -s, --size               Print the installed size of the package.\n"
@@ -440,6 +490,9 @@ cout <<
 "  -b, --batch              Do not ask for confirmation when removing or unlogging\n"
 "  -e, --skip=PATH:...      Do not remove files in PATHs (see the man page).\n"
 "  -U, --unlog              With -r: unlog the package, without removing any file.\n\n"
+"Package log format options:\n"
+"  -C, --convert=FORMAT     Convert the logs of the packages to FORMAT: 'text'\n"
+"                           or 'binary'.\n\n"
 "Package log options:\n"
 "  -l, --log                Enable log mode. See the man page.\n"
 "  -p, --package=PKG        Name of the package to be logged.\n" 
@@ -448,6 +501,12 @@ cout <<
 "  -+, --append             With -p or -D: If the package is already logged,\n"
 "                           append the list of files to its log.\n"
 "  -j, --log-missing        Do not skip missing files.\n"
+"  -N, --fanotify           Detect the files installed by the command with\n"
+"                           fanotify, instead of preloading libporg-log\n"
+"                           (Linux only, requires root).\n"
+"  -Z, --snapshot           Detect the files installed by the command comparing\n"
+"                           snapshots of the filesystem taken before and after\n"
+"                           running it, instead of preloading libporg-log.\n"
 "  -I, --include=PATH:...   List of paths to scan.\n"
 "  -E, --exclude=PATH:...   List of paths to skip.\n\n"
 "Note: The package list mode is enabled by default.\n\n"
@@ -26,7 +26,8 @@ enum {
    	MODE_INFO 		= 1 << 3,
    	MODE_CONF_OPTS 	= 1 << 4,
    	MODE_LOG 		= 1 << 5,
-   	MODE_REMOVE 	= 1 << 6
+   	MODE_REMOVE 	= 1 << 6,
+   	MODE_CONVERT 	= 1 << 7
 };
 
 
@@ -49,9 +50,12 @@ class Opt : public BaseOpt
 	static bool remove_unlog()		{ return s_remove_unlog; }
 	static bool log_append()		{ return s_log_append; }
 	static bool log_missing()		{ return s_log_missing; }
+	static bool log_fanotify()		{ return s_log_fanotify; }
+	static bool log_snapshot()		{ return s_log_snapshot; }
 	static bool reverse_sort() 		{ return s_reverse_sort; }
 	static bool print_date() 		{ return s_print_date; }
 	static bool print_hour() 		{ return s_print_hour; }
+	static bool convert_binary()	{ return s_convert_binary; }
 	static sort_t sort_type()		{ return s_sort_type; }
 	static int mode()				{ return s_mode; };
 	static std::string const& log_pkg_name()		{ return s_log_pkg_name; }
@@ -65,6 +69,7 @@ class Opt : public BaseOpt
 	static void check_required(char, std::string const&);
 	static void set_mode(int m, char optchar);
 	static void set_sort_type(std::string const&);
+	static void set_convert_format(std::string const&);
 
 	static bool s_all_pkgs;
 	static bool s_exact_version;
@@ -77,9 +82,12 @@ class Opt : public BaseOpt
 	static bool s_remove_unlog;
 	static bool s_log_append;
 	static bool s_log_missing;
+	static bool s_log_fanotify;
+	static bool s_log_snapshot;
 	static bool s_reverse_sort;
 	static bool s_print_date;
 	static bool s_print_hour;
+	static bool s_convert_binary;
 	static bool s_logdir_created;
 	static sort_t	s_sort_type;
 	static std::string s_log_pkg_name;
@@ -8,6 +8,7 @@
 
 #include "config.h"
 #include "out.h"
+#include "porg/common.h"	// Error, format_size()...
 #include <string>
 
 using std::string;
@@ -16,6 +17,11 @@ using namespace Porg;
 
 int Out::s_verbosity = QUIET;
 
+char Output::s_buf[Output::BUFSIZE];
+size_t Output::s_len = 0;
+char Output::s_eol = '\n';
+bool Output::s_tab = false;
+
 
 void Out::vrb(string const& msg, int errno_ /* = 0 */)
 {
@@ -57,3 +63,124 @@ void Out::dbg_title(string const& title /* = "" */)
 	cerr << '\n';
 }
 
+
+//--------//
+// Output //
+//--------//
+
+
+void Output::write(char const* p, size_t n)
+{
+	while (n) {
+
+		if (s_len == BUFSIZE)
+			drain();
+
+		size_t chunk = std::min(n, BUFSIZE - s_len);
+		memcpy(s_buf + s_len, p, chunk);
+		s_len += chunk;
+		p += chunk;
+		n -= chunk;
+	}
+}
+
+
+//
+// Print @n right aligned to @width (no padding in tab mode)
+//
+void Output::num(uint64_t n, int width /* = 0 */)
+{
+	char buf[NUM_BUFSIZE];
+	size_t len = format_num(buf, n);
+
+	pad(len, width);
+	write(buf, len);
+}
+
+
+//
+// Print @size in human readable form, right aligned to @width, or in bytes
+// in tab mode
+//
+void Output::size(float size_, int width /* = 0 */)
+{
+	if (s_tab) {
+		num(static_cast<ulong>(size_));
+		return;
+	}
+
+	char buf[SIZE_BUFSIZE];
+	size_t len = format_size(buf, size_);
+
+	pad(len, width);
+	write(buf, len);
+}
+
+
+//
+// Same as above, for the exact sizes of files, so that they are printed
+// unrounded in tab mode
+//
+void Output::size(uint64_t size_, int width /* = 0 */)
+{
+	if (s_tab)
+		num(size_);
+	else
+		size(float(size_), width);
+}
+
+
+void Output::date(time_t date_, bool print_hour)
+{
+	char buf[DATE_BUFSIZE];
+	write(buf, format_date(buf, date_, print_hour));
+}
+
+
+//
+// Width of @size printed by size()
+//
+int Output::size_width(float size_)
+{
+	char buf[SIZE_BUFSIZE];
+	return format_size(buf, size_);
+}
+
+
+//
+// Write out the buffered output. Return false if it fails.
+//
+bool Output::flush()
+{
+	for (char const* p = s_buf; s_len; ) {
+
+		ssize_t n = ::write(STDOUT_FILENO, p, s_len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			s_len = 0;
+			return false;
+		}
+
+		p += n;
+		s_len -= n;
+	}
+
+	return true;
+}
+
+
+void Output::drain()
+{
+	if (!flush())
+		throw Error("write()", errno);
+}
+
+
+void Output::pad(size_t len, int width)
+{
+	for (int i = s_tab ? 0 : width - int(len); i > 0; --i)
+		put(' ');
+}
+
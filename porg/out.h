@@ -10,7 +10,7 @@
 #define PORG_OUT_H
 
 #include "config.h"
-#include <iosfwd>
+#include <string>
 
 
 namespace Porg {
@@ -36,6 +36,57 @@ class Out
 	static int s_verbosity;
 };
 
+
+//
+// Buffered writer for the standard output, used by the list and query modes.
+// Numbers and sizes are formatted in place, without allocating memory.
+// With option -T, fields are separated by tabs, and sizes are printed in
+// bytes, without padding. With option -0, lines end with a NUL character.
+//
+class Output
+{
+	public:
+
+	// width of the sizes printed by size(), for sizes under 100 GB
+	static int const SIZE_COLUMN = 5;
+
+	static void set_null()	{ s_eol = '\0'; }
+	static void set_tab()	{ s_tab = true; }
+	static bool machine()	{ return s_tab || !s_eol; }
+	static bool tab()		{ return s_tab; }
+
+	static void put(char c)
+	{
+		if (s_len == BUFSIZE)
+			drain();
+		s_buf[s_len++] = c;
+	}
+
+	static void str(std::string const& s)	{ write(s.data(), s.size()); }
+	static void sep()						{ s_tab ? put('\t') : write("  ", 2); }
+	static void eol()						{ put(s_eol); }
+
+	static void write(char const*, size_t);
+	static void num(uint64_t, int width = 0);
+	static void size(float, int width = 0);
+	static void size(uint64_t, int width = 0);
+	static void date(time_t, bool print_hour);
+	static int size_width(float);
+	static bool flush();
+
+	protected:
+
+	static void drain();
+	static void pad(size_t len, int width);
+
+	static size_t const BUFSIZE = 1 << 18;
+
+	static char s_buf[BUFSIZE];
+	static size_t s_len;
+	static char s_eol;
+	static bool s_tab;
+};
+
 }	// namespace Porg
 
 
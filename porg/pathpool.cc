@@ -0,0 +1,145 @@
+//=======================================================================
+// pathpool.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#include "config.h"
+#include "porg/parallel.h"
+#include "pathpool.h"
+#include <algorithm>
+
+using std::string;
+using std::vector;
+using namespace Porg;
+
+static size_t const BLOCK_SIZE = 1 << 20;
+
+// below this, sorting in parallel doesn't pay off
+static size_t const PARALLEL_MIN = 1 << 16;
+
+static bool path_less(char const*, char const*);
+static size_t hash(char const*, size_t);
+
+
+PathPool::PathPool()
+:
+	m_blocks(),
+	m_next(0),
+	m_free(0),
+	m_paths(),
+	m_table(1024, 0)
+{ }
+
+
+//
+// Add @path, unless it's already there. Return whether it was added.
+//
+bool PathPool::add(string const& path)
+{
+	size_t mask = m_table.size() - 1;
+	size_t i = hash(path.data(), path.size()) & mask;
+
+	for ( ; m_table[i]; i = (i + 1) & mask) {
+		if (!strncmp(m_table[i], path.data(), path.size()) && !m_table[i][path.size()])
+			return false;
+	}
+
+	size_t len = path.size() + 1;
+
+	if (len > m_free) {
+		m_free = std::max(len, BLOCK_SIZE);
+		m_blocks.push_back(std::unique_ptr<char[]>(new char[m_free]));
+		m_next = m_blocks.back().get();
+	}
+
+	memcpy(m_next, path.c_str(), len);
+	m_paths.push_back(m_next);
+	m_table[i] = m_next;
+	m_next += len;
+	m_free -= len;
+
+	if (m_paths.size() * 2 > m_table.size())
+		grow_table();
+
+	return true;
+}
+
+
+//
+// Double the size of the hash table, and place the paths in it again
+//
+void PathPool::grow_table()
+{
+	vector<char const*> table(m_table.size() * 2, 0);
+	size_t mask = table.size() - 1;
+
+	for (vector<char const*>::const_iterator p(m_paths.begin()); p != m_paths.end(); ++p) {
+		size_t i = hash(*p, strlen(*p)) & mask;
+		while (table[i])
+			i = (i + 1) & mask;
+		table[i] = *p;
+	}
+
+	m_table.swap(table);
+}
+
+
+//
+// Sort the paths. Big lists are split into chunks that are sorted in
+// parallel, and then merged.
+//
+void PathPool::sort()
+{
+	size_t n = m_paths.size();
+	size_t nchunks = Workers::nthreads(n / PARALLEL_MIN + 1);
+	vector<size_t> bounds(nchunks + 1);
+	vector<char const*>::iterator first(m_paths.begin());
+
+	for (size_t i = 0; i <= nchunks; ++i)
+		bounds[i] = n * i / nchunks;
+
+	Workers(nchunks, [&](size_t i) {
+		std::sort(first + bounds[i], first + bounds[i + 1], path_less);
+	}).join();
+
+	// merge pairs of adjacent sorted chunks, until there's only one
+
+	for (size_t width = 1; width < nchunks; width *= 2) {
+
+		Workers((nchunks + 2 * width - 1) / (2 * width), [&](size_t i) {
+			size_t lo = 2 * width * i;
+			size_t mid = std::min(lo + width, nchunks);
+			size_t hi = std::min(lo + 2 * width, nchunks);
+			std::inplace_merge(first + bounds[lo], first + bounds[mid], first + bounds[hi], path_less);
+		}).join();
+	}
+}
+
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+static bool path_less(char const* left, char const* right)
+{
+	return strcmp(left, right) < 0;
+}
+
+
+//
+// FNV-1a
+//
+static size_t hash(char const* s, size_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+
+	for (char const* end = s + len; s < end; ++s)
+		h = (h ^ static_cast<unsigned char>(*s)) * 1099511628211ULL;
+
+	return h;
+}
+
@@ -0,0 +1,59 @@
+//=======================================================================
+// pathpool.h
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#ifndef PORG_PATHPOOL_H
+#define PORG_PATHPOOL_H
+
+#include "config.h"
+#include <memory>
+#include <vector>
+
+
+namespace Porg {
+
+//
+// Set of paths, stored one after another in big blocks of memory, instead
+// of one allocation per path. Paths are appended in any order, skipping
+// those already there (looked up in an open addressing hash table of
+// pointers into the blocks), and then sorted in one go with sort().
+//
+class PathPool
+{
+	public:
+
+	typedef std::vector<char const*>::const_iterator const_iter;
+
+	PathPool();
+
+	bool add(std::string const& path);
+	void sort();
+
+	const_iter begin() const	{ return m_paths.begin(); }
+	const_iter end() const		{ return m_paths.end(); }
+	size_t size() const			{ return m_paths.size(); }
+	bool empty() const			{ return m_paths.empty(); }
+
+	private:
+
+	PathPool(PathPool const&);
+	PathPool& operator=(PathPool const&);
+
+	void grow_table();
+
+	std::vector<std::unique_ptr<char[]> > m_blocks;
+	char* m_next;		// free space in the last block
+	size_t m_free;
+	std::vector<char const*> m_paths;
+	std::vector<char const*> m_table;	// size is a power of 2, at most half full
+
+};	// class PathPool
+
+}	// namespace Porg
+
+
+#endif  // PORG_PATHPOOL_H
@@ -10,28 +10,43 @@
 #include "pkg.h"
 #include "out.h"
 #include "opt.h"
-#include "db.h"
 #include "main.h"			// g_exit_status
-#include "porg/common.h"	// in_paths(), strip_trailing()
+#include "porg/common.h"	// strip_trailing()
+#include "porg/pathlist.h"
 #include "porg/file.h"
+#include "porg/binlog.h"
+#include "porg/index.h"
 #include <string>
-#include <iomanip>
 
 using std::string;
+using std::vector;
 using std::cout;
 using std::endl;
-using std::set;
-using std::setw;
 using namespace Porg;
 
 static void remove_parent_dir(string const& path);
+static void print_link_sep();
 
 
-Pkg::Pkg(string const& name_)
+//
+// If @header_only is set, the list of files is not read until it's needed
+//
+Pkg::Pkg(string const& name_, bool header_only /* = false */)
 :
 	BasePkg(name_)
 {
-	read_log();
+	read_log(header_only);
+}
+
+
+//
+// Package with just the fields of the header stored in the catalog
+//
+Pkg::Pkg(Catalog::Entry const& e)
+:
+	BasePkg(e.name)
+{
+	read_catalog(e);
 }
 
 
@@ -51,19 +66,20 @@ void Pkg::print_info() const
 }
 
 
-void Pkg::append(set<string> const& files_)
+void Pkg::append(vector<File*> const& files_)
 {
 	bool appended(false);
 
-	for (set<string>::const_iterator f(files_.begin()); f != files_.end(); ++f) {
-		if (!find_file(*f)) {
-			log_file(*f);
+	for (vector<File*>::const_iterator f(files_.begin()); f != files_.end(); ++f) {
+		if (!find_file((*f)->name())) {
+			log_file(**f);
 			appended = true;
 		}
 	}
 
+	// keep the format of the log
 	if (appended)
-		write_log();
+		write_log(m_binary_log);
 }
 
 
@@ -83,19 +99,25 @@ void Pkg::unlog() const
 
 void Pkg::list(int size_w, int nfiles_w) const
 {
-	if (Opt::print_sizes())
-		cout << setw(size_w) << fmt_size(m_size) << "  ";
+	if (Opt::print_sizes()) {
+		Output::size(m_size, size_w);
+		Output::sep();
+	}
 
-	if (Opt::print_nfiles())
-		cout << setw(nfiles_w) << m_nfiles << "  ";
+	if (Opt::print_nfiles()) {
+		Output::num(m_nfiles, nfiles_w);
+		Output::sep();
+	}
 
-	if (Opt::print_date())
-		cout << fmt_date(m_date, Opt::print_hour()) << "  ";
+	if (Opt::print_date()) {
+		Output::date(m_date, Opt::print_hour());
+		Output::sep();
+	}
 
 	if (!Opt::print_no_pkg_name())
-		cout << m_name;
+		Output::str(m_name);
 	
-	cout << endl;
+	Output::eol();
 }
 
 
@@ -103,36 +125,90 @@ void Pkg::list_files(int size_w)
 {
 	assert(size_w > 0);
 
-	sort_files(Opt::sort_type(), Opt::reverse_sort());
+	if (!Opt::print_no_pkg_name()) {
+		Output::str(m_name);
+		Output::put(':');
+		Output::eol();
+	}
 
-	if (!Opt::print_no_pkg_name())
-		cout << m_name << ":" << endl;
+	read_files();
+
+	// files in binary logs are already sorted by name, so list them in place
+	if (m_binlog && Opt::sort_type() == SORT_BY_NAME) {
+		list_binlog_files(size_w);
+		return;
+	}
+
+	sort_files(Opt::sort_type(), Opt::reverse_sort());
 
 	for (const_iter f(m_files.begin()); f != m_files.end(); ++f) {
 
-		if (Opt::print_sizes())
-			cout << setw(size_w) << fmt_size((*f)->size()) << "  ";
+		if (Opt::print_sizes()) {
+			Output::size(uint64_t((*f)->size()), size_w);
+			Output::sep();
+		}
 
-		cout << (*f)->name();
+		Output::str((*f)->name());
 
-		if (Opt::print_symlinks() && (*f)->is_symlink())
-			cout << " -> " << (*f)->ln_name();
+		if (Opt::print_symlinks() && (*f)->is_symlink()) {
+			print_link_sep();
+			Output::str((*f)->ln_name());
+		}
 
-		cout << endl;
+		Output::eol();
 	}
 }
 
 
-void Pkg::remove(DB const& db)
+void Pkg::list_binlog_files(int size_w) const
 {
+	size_t n = m_binlog->nfiles();
+
+	for (size_t i = 0; i < n; ++i) {
+
+		BinLog::Record const& r = m_binlog->record(Opt::reverse_sort() ? n - i - 1 : i);
+
+		if (Opt::print_sizes()) {
+			Output::size(r.size, size_w);
+			Output::sep();
+		}
+
+		Output::write(m_binlog->name(r), r.name_len);
+
+		if (Opt::print_symlinks() && r.ln_name_len) {
+			print_link_sep();
+			Output::write(m_binlog->ln_name(r), r.ln_name_len);
+		}
+
+		Output::eol();
+	}
+}
+
+
+bool Pkg::convert(bool binary) const
+{
+	if (m_binary_log == binary)
+		return false;
+
+	write_log(binary);
+	return true;
+}
+
+
+void Pkg::remove(SharedFiles const& shared)
+{
+	load_files();
+
+	PathList const skip(Opt::remove_skip());
+
 	for (iter f(m_files.begin()); f != m_files.end(); ++f) {
 
 		// skip excluded
-		if (in_paths((*f)->name(), Opt::remove_skip()))
+		if (skip.match((*f)->name()))
 			Out::vrb((*f)->name() + ": excluded");
 
 		// skip shared files
-		else if (is_shared(*f, db))
+		else if (shared.is_shared((*f)->name()))
 			Out::vrb((*f)->name() + ": shared");
 
 		// remove file
@@ -153,6 +229,11 @@ void Pkg::remove(DB const& db)
 }
 
 
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
 static void remove_parent_dir(string const& path)
 {
 	string dir(strip_trailing(path, '/'));
@@ -167,3 +248,15 @@ static void remove_parent_dir(string const& path)
 	}
 }
 
+
+//
+// Separator between a symlink and its contents
+//
+static void print_link_sep()
+{
+	if (Output::tab())
+		Output::put('\t');
+	else
+		Output::write(" -> ", 4);
+}
+
@@ -12,27 +12,33 @@
 #include "config.h"
 #include "porg/basepkg.h"
 #include <iosfwd>
-#include <set>
+#include <vector>
 
 
 namespace Porg
 {
 
-class DB;
+class SharedFiles;
 
 class Pkg : public BasePkg
 {
 	public:
 
-	Pkg(std::string const& name_);
+	Pkg(std::string const& name_, bool header_only = false);
+	Pkg(Catalog::Entry const&);
 	
 	void unlog() const;
-	void remove(DB const&);
+	void remove(SharedFiles const&);
 	void print_conf_opts(bool print_pkg_name) const;
 	void print_info() const;
 	void list(int, int) const;
 	void list_files(int size_w);
-	void append(std::set<std::string> const& files);
+	void append(std::vector<File*> const& files);
+	bool convert(bool binary) const;
+
+	protected:
+
+	void list_binlog_files(int size_w) const;
 
 };	// class Pkg
 
@@ -0,0 +1,442 @@
+//=======================================================================
+// snapshot.cc
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#include "config.h"
+#include "porg/common.h"	// in_paths()
+#include "porg/baseopt.h"
+#include "porg/mapfile.h"
+#include "porg/parallel.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <dirent.h>
+#include <fcntl.h>
+
+using std::string;
+using std::vector;
+using namespace Porg;
+
+static char const HEADER[] = "#!porg-snapshot\n";
+
+static void get_roots(string const& include, string const& exclude, vector<string>&);
+static string join(string const& dir, string const& name);
+static int64_t mtime_ns(struct stat const&);
+static int64_t ctime_ns(struct stat const&);
+static int64_t now_ns();
+template <typename T> static bool get_num(char const*&, char const*, T&);
+
+
+Snapshot::Snapshot(string const& include, string const& exclude)
+:
+	m_include(include),
+	m_exclude(exclude),
+	m_exclude_list(exclude),
+	m_dirs()
+{ }
+
+
+string Snapshot::cache_file()
+{
+	return BaseOpt::logdir() + "/.porg-snapshot";
+}
+
+
+//
+// Read the directories under the included paths, skipping the excluded ones.
+// Directories that have not been modified since the snapshot @cache (if any)
+// was taken are not read again, but the names in them are taken from it (and
+// only stat'ed).
+//
+void Snapshot::scan(Snapshot const* cache /* = 0 */)
+{
+	// directories waiting to be read, and number of them being read
+	vector<string> queue;
+	size_t busy = 0;
+	std::mutex mutex;
+	std::condition_variable cond;
+
+	m_dirs.clear();
+	get_roots(m_include, m_exclude, queue);
+
+	Workers workers(Workers::nthreads(std::numeric_limits<size_t>::max()), [&](size_t) {
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (true) {
+
+			// no more directories, and none to come
+			cond.wait(lock, [&] { return !queue.empty() || !busy; });
+			if (queue.empty())
+				break;
+
+			string path(queue.back());
+			queue.pop_back();
+			busy++;
+			lock.unlock();
+
+			Listing dir;
+			vector<string> subdirs;
+			bool ok;
+
+			try
+			{
+				ok = read_dir(path, cache, dir, subdirs);
+			}
+			catch (...)
+			{
+				lock.lock();
+				busy--;
+				cond.notify_all();
+				throw;
+			}
+
+			lock.lock();
+
+			if (ok)
+				m_dirs[path] = std::move(dir);
+
+			queue.insert(queue.end(), subdirs.begin(), subdirs.end());
+			busy--;
+			cond.notify_all();
+		}
+	});
+
+	workers.join();
+}
+
+
+//
+// Get the contents of the directory @path into @dir, and append to @subdirs
+// the (not excluded) directories in it. Return false if it can't be read.
+//
+bool Snapshot::read_dir(string const& path, Snapshot const* cache, Listing& dir,
+	vector<string>& subdirs) const
+{
+	struct stat s;
+	int64_t now = now_ns();
+
+	int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &s) < 0) {
+		close(fd);
+		return false;
+	}
+
+	dir.ino = s.st_ino;
+	dir.mtime = mtime_ns(s);
+
+	// A directory modified in the same clock tick as it's read may be
+	// modified again in that tick, after being read, without its mtime
+	// changing: don't use it as a cache then.
+	dir.cacheable = dir.mtime < now;
+
+	std::unordered_map<string, Listing>::const_iterator c;
+
+	// The names in a directory not modified since the cached snapshot was
+	// taken are the same, so it needn't be read again. Its files may have
+	// been modified in place though, so they must be stat'ed anyway.
+
+	if (cache && (c = cache->m_dirs.find(path)) != cache->m_dirs.end() && c->second.cacheable
+	&& c->second.ino == dir.ino && c->second.mtime == dir.mtime) {
+
+		dir.entries.reserve(c->second.entries.size());
+
+		for (vector<Entry>::const_iterator e(c->second.entries.begin()); e != c->second.entries.end(); ++e) {
+			Entry entry;
+			if (stat_entry(fd, e->name.c_str(), entry))
+				dir.entries.push_back(entry);
+		}
+
+		close(fd);
+	}
+
+	else {
+
+		DIR* d = fdopendir(fd);
+		if (!d) {
+			close(fd);
+			return false;
+		}
+
+		for (struct dirent* e; (e = readdir(d)); ) {
+
+			Entry entry;
+
+			if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")
+			|| !stat_entry(fd, e->d_name, entry))
+				continue;
+
+			// the cache file is line oriented
+			if (strchr(e->d_name, '\n'))
+				dir.cacheable = false;
+
+			dir.entries.push_back(entry);
+		}
+
+		closedir(d);
+
+		std::sort(dir.entries.begin(), dir.entries.end(),
+			[](Entry const& a, Entry const& b) { return a.name < b.name; });
+	}
+
+	for (vector<Entry>::const_iterator e(dir.entries.begin()); e != dir.entries.end(); ++e) {
+		if (e->is_dir) {
+			string sub(join(path, e->name));
+			if (!m_exclude_list.match(sub))
+				subdirs.push_back(sub);
+		}
+	}
+
+	return true;
+}
+
+
+//
+// Fill @entry with the metadata of the file @name in the directory @dirfd.
+// Return false if it can't be stat'ed (e.g. it has been removed).
+//
+bool Snapshot::stat_entry(int dirfd, char const* name, Entry& entry)
+{
+	struct stat s;
+
+	if (fstatat(dirfd, name, &s, AT_SYMLINK_NOFOLLOW) < 0)
+		return false;
+
+	entry.name = name;
+	entry.ino = s.st_ino;
+	entry.size = s.st_size;
+	entry.mtime = mtime_ns(s);
+	entry.ctime = ctime_ns(s);
+	entry.is_dir = S_ISDIR(s.st_mode);
+	return true;
+}
+
+
+//
+// Append to @files the paths of the non directory files that have been
+// created or modified since the snapshot @before was taken
+//
+void Snapshot::get_changes(Snapshot const& before, vector<string>& files) const
+{
+	vector<Entry> const none;
+
+	for (std::unordered_map<string, Listing>::const_iterator d(m_dirs.begin()); d != m_dirs.end(); ++d) {
+
+		std::unordered_map<string, Listing>::const_iterator b = before.m_dirs.find(d->first);
+		vector<Entry> const& old = b != before.m_dirs.end() ? b->second.entries : none;
+		vector<Entry>::const_iterator o(old.begin());
+
+		// both lists are sorted by name
+		for (vector<Entry>::const_iterator e(d->second.entries.begin()); e != d->second.entries.end(); ++e) {
+
+			if (e->is_dir)
+				continue;
+
+			while (o != old.end() && o->name < e->name)
+				++o;
+
+			if (o == old.end() || o->name != e->name || o->ino != e->ino
+			|| o->size != e->size || o->mtime != e->mtime || o->ctime != e->ctime)
+				files.push_back(join(d->first, e->name));
+		}
+	}
+}
+
+
+//
+// Load a snapshot saved by save(). Return false if the file can't be read,
+// or if it was taken with other include or exclude paths.
+//
+bool Snapshot::load(string const& path)
+{
+	m_dirs.clear();
+
+	try
+	{
+		MapFile map(path);
+		string head(HEADER + m_include + "\n" + m_exclude + "\n");
+
+		if (map.size() < head.size() || memcmp(map.begin(), head.data(), head.size()))
+			return false;
+
+		Listing* dir = 0;
+		bool ok = true;
+
+		for (char const* p = map.begin() + head.size(), *eol; ok && p < map.end(); p = eol + 1) {
+
+			if (!(eol = static_cast<char const*>(memchr(p, '\n', map.end() - p))))
+				eol = map.end();
+
+			char type = *p++;
+
+			if (type == '=') {
+				uint64_t ino;
+				int64_t mtime;
+				if (!(ok = get_num(p, eol, ino) && get_num(p, eol, mtime)))
+					continue;
+				dir = &m_dirs[string(p, eol)];
+				dir->ino = ino;
+				dir->mtime = mtime;
+				dir->cacheable = true;
+			}
+
+			else if ((type == 'd' || type == 'f') && dir) {
+				Entry e;
+				if (!(ok = get_num(p, eol, e.ino) && get_num(p, eol, e.size)
+				&& get_num(p, eol, e.mtime) && get_num(p, eol, e.ctime)))
+					continue;
+				e.name.assign(p, eol);
+				e.is_dir = type == 'd';
+				dir->entries.push_back(e);
+			}
+
+			else
+				ok = false;
+		}
+
+		if (ok)
+			return true;
+	}
+	catch (Error const&) { }
+
+	m_dirs.clear();
+	return false;
+}
+
+
+//
+// Save the snapshot into the file @path. Format:
+//
+//		#!porg-snapshot
+//		<include paths>
+//		<exclude paths>
+//		=<inode> <mtime> <directory path>
+//		<d|f><inode> <size> <mtime> <ctime> <name>	(one per entry)
+//		...
+//
+void Snapshot::save(string const& path) const
+{
+	AtomicStream os(path);
+
+	os << HEADER << m_include << '\n' << m_exclude << '\n';
+
+	for (std::unordered_map<string, Listing>::const_iterator d(m_dirs.begin()); d != m_dirs.end(); ++d) {
+
+		if (!d->second.cacheable)
+			continue;
+
+		os << '=' << d->second.ino << ' ' << d->second.mtime << ' ' << d->first << '\n';
+
+		for (vector<Entry>::const_iterator e(d->second.entries.begin()); e != d->second.entries.end(); ++e) {
+			os << (e->is_dir ? 'd' : 'f') << e->ino << ' ' << e->size << ' '
+				<< e->mtime << ' ' << e->ctime << ' ' << e->name << '\n';
+		}
+	}
+
+	os.commit();
+}
+
+
+//-------------------//
+// static free funcs //
+//-------------------//
+
+
+//
+// Get the paths to be scanned: those in @include (not patterns) which are
+// neither excluded nor inside another one
+//
+static void get_roots(string const& include, string const& exclude, vector<string>& roots)
+{
+	std::istringstream is(include + ":");
+	vector<string> paths;
+
+	for (string path; getline(is, path, ':'); ) {
+		if (!path.empty() && path.find_first_of("*?[") == string::npos) {
+			path = strip_trailing(path, '/');
+			paths.push_back(path.empty() ? "/" : path);
+		}
+	}
+
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	for (vector<string>::const_iterator p(paths.begin()); p != paths.end(); ++p) {
+
+		bool nested = false;
+
+		for (vector<string>::const_iterator q(paths.begin()); !nested && q != paths.end(); ++q)
+			nested = q != p && in_paths(*p, *q);
+
+		if (!nested && !in_paths(*p, exclude))
+			roots.push_back(*p);
+	}
+}
+
+
+static string join(string const& dir, string const& name)
+{
+	return (dir == "/" ? dir : dir + "/") + name;
+}
+
+
+static int64_t mtime_ns(struct stat const& s)
+{
+#ifdef __APPLE__
+	return s.st_mtimespec.tv_sec * int64_t(1000000000) + s.st_mtimespec.tv_nsec;
+#else
+	return s.st_mtim.tv_sec * int64_t(1000000000) + s.st_mtim.tv_nsec;
+#endif
+}
+
+
+static int64_t ctime_ns(struct stat const& s)
+{
+#ifdef __APPLE__
+	return s.st_ctimespec.tv_sec * int64_t(1000000000) + s.st_ctimespec.tv_nsec;
+#else
+	return s.st_ctim.tv_sec * int64_t(1000000000) + s.st_ctim.tv_nsec;
+#endif
+}
+
+
+//
+// Current time, from the clock the filesystems take the timestamps from:
+// files changed later get timestamps not earlier than it
+//
+static int64_t now_ns()
+{
+	struct timespec t;
+#ifdef CLOCK_REALTIME_COARSE
+	clock_gettime(CLOCK_REALTIME_COARSE, &t);
+#else
+	clock_gettime(CLOCK_REALTIME, &t);
+#endif
+	return t.tv_sec * int64_t(1000000000) + t.tv_nsec;
+}
+
+
+//
+// Read a decimal number followed by a space from [@p, @eol), and move @p
+// past them
+//
+template <typename T>
+static bool get_num(char const*& p, char const* eol, T& num)
+{
+	char const* end = parse_num(p, eol, num);
+
+	if (end == p || end == eol || *end != ' ')
+		return false;
+
+	p = end + 1;
+	return true;
+}
+
@@ -0,0 +1,77 @@
+//=======================================================================
+// snapshot.h
+//-----------------------------------------------------------------------
+// This file is part of the package porg
+// Copyright (C) 2015 David Ricart
+// For more information visit https://jbrubake.github.io/porg
+//=======================================================================
+
+#ifndef PORG_SNAPSHOT_H
+#define PORG_SNAPSHOT_H
+
+#include "config.h"
+#include "porg/pathlist.h"
+#include <unordered_map>
+#include <vector>
+
+
+namespace Porg {
+
+//
+// Metadata (inode, size, mtime and ctime) of the files under a list of
+// paths, taken at some point in time. Comparing two snapshots, taken
+// before and after running a command, tells which files it created or
+// modified, whatever the way it did it.
+//
+// The directories are read in parallel. A snapshot can be saved to a cache
+// file, so that the next snapshot only reads again the directories modified
+// since then (the files in the others are stat'ed all the same).
+//
+class Snapshot
+{
+	public:
+
+	Snapshot(std::string const& include, std::string const& exclude);
+
+	void scan(Snapshot const* cache = 0);
+	void get_changes(Snapshot const& before, std::vector<std::string>& files) const;
+	bool load(std::string const& path);
+	void save(std::string const& path) const;
+
+	static std::string cache_file();
+
+	private:
+
+	struct Entry
+	{
+		std::string name;
+		uint64_t ino;
+		uint64_t size;
+		int64_t mtime;	// nanoseconds
+		int64_t ctime;
+		bool is_dir;
+	};
+
+	struct Listing
+	{
+		uint64_t ino;
+		int64_t mtime;
+		std::vector<Entry> entries;		// sorted by name
+		bool cacheable;
+	};
+
+	bool read_dir(std::string const& path, Snapshot const* cache, Listing&,
+		std::vector<std::string>& subdirs) const;
+	static bool stat_entry(int dirfd, char const* name, Entry&);
+
+	std::string const m_include;
+	std::string const m_exclude;
+	PathList const m_exclude_list;
+	std::unordered_map<std::string, Listing> m_dirs;
+
+};	// class Snapshot
+
+}	// namespace Porg
+
+
+#endif  // PORG_SNAPSHOT_H
@@ -10,6 +10,7 @@
 #include "util.h"
 #include "porg/common.h"	// Error, strip_trailing()
 #include <string>
+#include <unordered_map>
 
 using std::string;
 using namespace Porg;
@@ -18,9 +19,14 @@ using namespace Porg;
 //
 // Like libc's realpath(), but it only resolves symlinks in the partial
 // directories of the path, thereby retaining symlinks as symlinks.
+// Since files use to be logged in bunches into the same few directories,
+// the real paths of the directories are remembered for the next calls.
 //
 string Porg::clear_path(string const& inpath)
 {
+	static std::unordered_map<string, string> real_dirs;
+	static string cwd;
+
 	if (inpath.empty())
 		return inpath;
 
@@ -29,9 +35,12 @@ string Porg::clear_path(string const& inpath)
 	// absolutize path
 
 	if (path[0] != '/') {
-		char cwd[4096];
-		if (getcwd(cwd, sizeof(cwd)))
-			path.insert(0, string(cwd) + "/");
+		if (cwd.empty()) {
+			char buf[4096];
+			if (getcwd(buf, sizeof(buf)))
+				cwd = string(buf) + "/";
+		}
+		path.insert(0, cwd);
 	}
 
 	path = strip_trailing(path, '/');
@@ -44,12 +53,16 @@ string Porg::clear_path(string const& inpath)
 
 	// get realpath of dirname
 
+	std::unordered_map<string, string>::const_iterator r = real_dirs.find(dir);
+	if (r != real_dirs.end())
+		return r->second + "/" + base;
+
 	char real_dir[4096];
 
 	if (!::realpath(dir.c_str(), real_dir))
 		return path;
 
-	return string(real_dir) + "/" + base;
+	return (real_dirs[dir] = real_dir) + "/" + base;
 }
 
 